@@ -0,0 +1,442 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * copy_engine.c - copy to pmem with an explicitly chosen strategy
+ *
+ * Transfers are grouped into power of two size classes from 256 bytes
+ * to 4M. Each class has its own strategy, so calibration can settle on
+ * e.g. cached stores for small copies and streaming stores for large ones.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <libpmem.h>
+
+#include "copy_engine.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COPY_ENGINE_X86
+#include <immintrin.h>
+#endif
+
+/* size classes are 1 << CLASS_MIN_SHIFT ... 1 << CLASS_MAX_SHIFT bytes */
+#define CLASS_MIN_SHIFT 8
+#define CLASS_MAX_SHIFT 22
+#define NCLASSES (CLASS_MAX_SHIFT - CLASS_MIN_SHIFT + 1)
+
+/* runs of each strategy for each size class, the fastest one counts */
+#define CALIB_RUNS 3
+
+/*
+ * bytes copied to time one strategy for one size class, also the size
+ * of the scratch file, which must hold at least the largest class
+ */
+#define CALIB_BYTES (16 << 20)
+
+static const char *names[COPY_STRATEGIES] = {
+	"default",
+	"nontemporal",
+	"temporal",
+	"avx2",
+	"avx512",
+};
+
+/* strategy used for each size class */
+static enum copy_strategy strategies[NCLASSES];
+
+/*
+ * size_class - index of the class len belongs to
+ */
+static unsigned
+size_class(size_t len)
+{
+	unsigned shift = CLASS_MIN_SHIFT;
+
+	while (shift < CLASS_MAX_SHIFT && (len >> (shift + 1)) != 0)
+		shift++;
+
+	return shift - CLASS_MIN_SHIFT;
+}
+
+#ifdef COPY_ENGINE_X86
+/*
+ * memcpy_avx2 - copy with 32-byte non-temporal stores
+ *
+ * The unaligned head and tail are left to libpmem. Streaming stores
+ * do not need flushing, the sfence in pmem_drain() orders them.
+ */
+__attribute__((target("avx2")))
+static void
+memcpy_avx2(char *dst, const char *src, size_t len)
+{
+	size_t head = (size_t)(-(uintptr_t)dst & 31);
+
+	if (head > len)
+		head = len;
+	if (head) {
+		pmem_memcpy_nodrain(dst, src, head);
+		dst += head;
+		src += head;
+		len -= head;
+	}
+
+	for (; len >= 128; dst += 128, src += 128, len -= 128) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)src);
+		__m256i b = _mm256_loadu_si256((const __m256i *)src + 1);
+		__m256i c = _mm256_loadu_si256((const __m256i *)src + 2);
+		__m256i d = _mm256_loadu_si256((const __m256i *)src + 3);
+		_mm256_stream_si256((__m256i *)dst, a);
+		_mm256_stream_si256((__m256i *)dst + 1, b);
+		_mm256_stream_si256((__m256i *)dst + 2, c);
+		_mm256_stream_si256((__m256i *)dst + 3, d);
+	}
+
+	for (; len >= 32; dst += 32, src += 32, len -= 32)
+		_mm256_stream_si256((__m256i *)dst,
+			_mm256_loadu_si256((const __m256i *)src));
+
+	if (len)
+		pmem_memcpy_nodrain(dst, src, len);
+}
+
+/*
+ * memcpy_avx512 - copy with 64-byte non-temporal stores, one cache line
+ *                 per store
+ */
+__attribute__((target("avx512f")))
+static void
+memcpy_avx512(char *dst, const char *src, size_t len)
+{
+	size_t head = (size_t)(-(uintptr_t)dst & 63);
+
+	if (head > len)
+		head = len;
+	if (head) {
+		pmem_memcpy_nodrain(dst, src, head);
+		dst += head;
+		src += head;
+		len -= head;
+	}
+
+	for (; len >= 256; dst += 256, src += 256, len -= 256) {
+		__m512i a = _mm512_loadu_si512((const void *)src);
+		__m512i b = _mm512_loadu_si512((const void *)(src + 64));
+		__m512i c = _mm512_loadu_si512((const void *)(src + 128));
+		__m512i d = _mm512_loadu_si512((const void *)(src + 192));
+		_mm512_stream_si512((void *)dst, a);
+		_mm512_stream_si512((void *)(dst + 64), b);
+		_mm512_stream_si512((void *)(dst + 128), c);
+		_mm512_stream_si512((void *)(dst + 192), d);
+	}
+
+	for (; len >= 64; dst += 64, src += 64, len -= 64)
+		_mm512_stream_si512((void *)dst,
+			_mm512_loadu_si512((const void *)src));
+
+	if (len)
+		pmem_memcpy_nodrain(dst, src, len);
+}
+#endif
+
+/*
+ * copy_strategy_name - name of strategy s, as accepted by
+ *                      copy_strategy_parse()
+ */
+const char *
+copy_strategy_name(enum copy_strategy s)
+{
+	return names[s];
+}
+
+/*
+ * copy_strategy_parse - find the strategy with the given name
+ */
+int
+copy_strategy_parse(const char *name, enum copy_strategy *s)
+{
+	int i;
+
+	for (i = 0; i < COPY_STRATEGIES; i++) {
+		if (strcmp(name, names[i]) == 0) {
+			*s = (enum copy_strategy)i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * copy_strategy_supported - check if this CPU can run strategy s
+ */
+int
+copy_strategy_supported(enum copy_strategy s)
+{
+	switch (s) {
+#ifdef COPY_ENGINE_X86
+	case COPY_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case COPY_AVX512:
+		return __builtin_cpu_supports("avx512f");
+#else
+	case COPY_AVX2:
+	case COPY_AVX512:
+		return 0;
+#endif
+	default:
+		return 1;
+	}
+}
+
+/*
+ * copy_engine_set - use strategy s for copies of any size
+ */
+void
+copy_engine_set(enum copy_strategy s)
+{
+	unsigned i;
+
+	for (i = 0; i < NCLASSES; i++)
+		strategies[i] = s;
+}
+
+/*
+ * copy_engine_memcpy_nodrain - copy len bytes to pmem with the strategy
+ *                              of its size class, without draining
+ */
+void
+copy_engine_memcpy_nodrain(char *pmemdest, const char *src, size_t len)
+{
+	switch (strategies[size_class(len)]) {
+	case COPY_NONTEMPORAL:
+		pmem_memcpy(pmemdest, src, len,
+			PMEM_F_MEM_NONTEMPORAL|PMEM_F_MEM_NODRAIN);
+		break;
+	case COPY_TEMPORAL:
+		pmem_memcpy(pmemdest, src, len,
+			PMEM_F_MEM_TEMPORAL|PMEM_F_MEM_NODRAIN);
+		break;
+#ifdef COPY_ENGINE_X86
+	case COPY_AVX2:
+		memcpy_avx2(pmemdest, src, len);
+		break;
+	case COPY_AVX512:
+		memcpy_avx512(pmemdest, src, len);
+		break;
+#endif
+	default:
+		pmem_memcpy_nodrain(pmemdest, src, len);
+		break;
+	}
+}
+
+/*
+ * copy_engine_calibrate - time every supported strategy for every size
+ *                         class and pick the fastest one
+ *
+ * The strategies are timed on a scratch file of CALIB_BYTES created at
+ * scratch_path, so every class streams through more memory than fits in
+ * the caches. The file is written once before timing, so that no strategy
+ * is charged with its page faults, and the best of CALIB_RUNS runs of each
+ * strategy counts. The file is removed afterwards. Returns -1 and leaves
+ * the default strategy in place if the scratch file cannot be created or
+ * is not pmem.
+ */
+int
+copy_engine_calibrate(const char *scratch_path)
+{
+	size_t max = (size_t)1 << CLASS_MAX_SHIFT;
+	struct timespec start, stop;
+	enum copy_strategy s;
+	size_t mapped_len;
+	char *pmemaddr;
+	int is_pmem;
+	unsigned c, run;
+	char *src;
+
+	copy_engine_set(COPY_DEFAULT);
+
+	if ((pmemaddr = pmem_map_file(scratch_path, CALIB_BYTES,
+				PMEM_FILE_CREATE|PMEM_FILE_EXCL,
+				0666, &mapped_len, &is_pmem)) == NULL) {
+		perror(scratch_path);
+		return -1;
+	}
+	unlink(scratch_path);
+
+	if (!is_pmem) {
+		fprintf(stderr, "%s: not pmem, cannot calibrate\n",
+			scratch_path);
+		pmem_unmap(pmemaddr, mapped_len);
+		return -1;
+	}
+
+	if ((src = malloc(max)) == NULL) {
+		perror("malloc");
+		exit(1);
+	}
+	memset(src, 0xa5, max);
+
+	pmem_memset_persist(pmemaddr, 0, CALIB_BYTES);
+
+	for (c = 0; c < NCLASSES; c++) {
+		size_t size = (size_t)1 << (c + CLASS_MIN_SHIFT);
+		enum copy_strategy best = COPY_DEFAULT;
+		double best_secs = 0;
+
+		for (s = COPY_DEFAULT; s < COPY_STRATEGIES; s++) {
+			size_t off;
+			double secs;
+
+			if (!copy_strategy_supported(s))
+				continue;
+
+			strategies[c] = s;
+			for (run = 0; run < CALIB_RUNS; run++) {
+				clock_gettime(CLOCK_MONOTONIC, &start);
+				for (off = 0; off + size <= CALIB_BYTES;
+						off += size)
+					copy_engine_memcpy_nodrain(
+						pmemaddr + off, src, size);
+				pmem_drain();
+				clock_gettime(CLOCK_MONOTONIC, &stop);
+
+				secs = (stop.tv_sec - start.tv_sec) +
+					(stop.tv_nsec - start.tv_nsec) / 1e9;
+				if (best_secs == 0 || secs < best_secs) {
+					best = s;
+					best_secs = secs;
+				}
+			}
+		}
+
+		strategies[c] = best;
+	}
+
+	free(src);
+	pmem_unmap(pmemaddr, mapped_len);
+
+	return 0;
+}
+
+/*
+ * copy_engine_load - read the strategies saved by copy_engine_save()
+ *
+ * Returns -1 and leaves the current strategies in place if the file
+ * cannot be read or names a strategy this CPU does not support.
+ */
+int
+copy_engine_load(const char *path)
+{
+	enum copy_strategy loaded[NCLASSES];
+	char line[128];
+	char name[32];
+	unsigned long long size;
+	unsigned seen = 0;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return -1;
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		enum copy_strategy s;
+		unsigned c;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		if (sscanf(line, "%llu %31s", &size, name) != 2 ||
+				copy_strategy_parse(name, &s) < 0 ||
+				!copy_strategy_supported(s)) {
+			fprintf(stderr, "%s: invalid line: %s", path, line);
+			fclose(fp);
+			return -1;
+		}
+
+		c = size_class(size);
+		loaded[c] = s;
+		seen |= 1U << c;
+	}
+
+	fclose(fp);
+
+	if (seen != (1U << NCLASSES) - 1) {
+		fprintf(stderr, "%s: missing size classes\n", path);
+		return -1;
+	}
+
+	memcpy(strategies, loaded, sizeof(strategies));
+
+	return 0;
+}
+
+/*
+ * copy_engine_save - write the strategy of each size class to a file
+ */
+int
+copy_engine_save(const char *path)
+{
+	unsigned c;
+	FILE *fp;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		return -1;
+
+	fprintf(fp, "# size strategy\n");
+	for (c = 0; c < NCLASSES; c++)
+		fprintf(fp, "%zu %s\n", (size_t)1 << (c + CLASS_MIN_SHIFT),
+			names[strategies[c]]);
+
+	if (fclose(fp) != 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * copy_engine_print - show the strategy of each size class
+ */
+void
+copy_engine_print(void)
+{
+	unsigned c;
+
+	for (c = 0; c < NCLASSES; c++)
+		printf("%8zu bytes: %s\n", (size_t)1 << (c + CLASS_MIN_SHIFT),
+			names[strategies[c]]);
+}
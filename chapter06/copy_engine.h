@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * copy_engine.h - explicit choice of the instructions used to copy to pmem
+ *
+ * pmem_memcpy_nodrain() picks its copy strategy internally. The copy engine
+ * lets the caller pick one instead, either one strategy for all copies or,
+ * after copy_engine_calibrate(), the fastest one for each transfer size.
+ */
+
+#ifndef COPY_ENGINE_H
+#define COPY_ENGINE_H
+
+#include <stddef.h>
+
+enum copy_strategy {
+	COPY_DEFAULT,		/* pmem_memcpy_nodrain() decides */
+	COPY_NONTEMPORAL,	/* PMEM_F_MEM_NONTEMPORAL, bypass the caches */
+	COPY_TEMPORAL,		/* PMEM_F_MEM_TEMPORAL, cached stores + flush */
+	COPY_AVX2,		/* 32-byte streaming stores */
+	COPY_AVX512,		/* 64-byte streaming stores */
+	COPY_STRATEGIES
+};
+
+const char *copy_strategy_name(enum copy_strategy s);
+int copy_strategy_parse(const char *name, enum copy_strategy *s);
+int copy_strategy_supported(enum copy_strategy s);
+
+void copy_engine_set(enum copy_strategy s);
+int copy_engine_calibrate(const char *scratch_path);
+int copy_engine_load(const char *path);
+int copy_engine_save(const char *path);
+void copy_engine_print(void);
+
+void copy_engine_memcpy_nodrain(char *pmemdest, const char *src, size_t len);
+
+#endif
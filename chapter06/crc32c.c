@@ -0,0 +1,124 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * crc32c.c - CRC32C (Castagnoli) checksums
+ *
+ * Uses the SSE4.2 crc32 instruction when the CPU has it and a lookup
+ * table otherwise. crc32c_init() must be called before the first checksum.
+ */
+
+#include <string.h>
+
+#include "crc32c.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32C_X86
+#include <immintrin.h>
+#endif
+
+/* reflected Castagnoli polynomial */
+#define CRC32C_POLY 0x82f63b78
+
+static uint32_t table[256];
+
+static uint32_t (*crc32c_impl)(uint32_t, const unsigned char *, size_t);
+
+/*
+ * crc32c_table - one byte at a time
+ */
+static uint32_t
+crc32c_table(uint32_t crc, const unsigned char *p, size_t len)
+{
+	while (len--)
+		crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#ifdef CRC32C_X86
+/*
+ * crc32c_sse42 - eight bytes at a time with the crc32 instruction
+ */
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t crc, const unsigned char *p, size_t len)
+{
+#ifdef __x86_64__
+	uint64_t crc64 = crc;
+	uint64_t word;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&word, p, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+	}
+	crc = (uint32_t)crc64;
+#endif
+
+	for (; len > 0; p++, len--)
+		crc = _mm_crc32_u8(crc, *p);
+
+	return crc;
+}
+#endif
+
+/*
+ * crc32c_init - build the lookup table and pick the implementation
+ */
+void
+crc32c_init(void)
+{
+	uint32_t crc;
+	unsigned i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+		table[i] = crc;
+	}
+
+	crc32c_impl = crc32c_table;
+#ifdef CRC32C_X86
+	if (__builtin_cpu_supports("sse4.2"))
+		crc32c_impl = crc32c_sse42;
+#endif
+}
+
+/*
+ * crc32c - extend crc (0 for the first call) with len bytes of buf
+ */
+uint32_t
+crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	return ~crc32c_impl(~crc, buf, len);
+}
@@ -33,13 +33,55 @@
 /*
  * full_copy.c - show how to use pmem_memcpy_nodrain()
  *
- * usage: full_copy src-file dst-file
+ * usage: full_copy [-t threads] [-c chunk-size] [-m read|mmap|direct]
+ *		[-b buffer-size] [-u] [-s strategy|auto] [-f calibration-file]
+ *		[-k] src-file dst-file
  *
  * Copies src-file to dst-file in 4k chunks.
+ *
+ * With -t the file is split into chunks of chunk-size bytes (1M by
+ * default, k, m and g suffixes are accepted) which are copied by the given
+ * number of threads. Each thread copies every threads-th chunk to its own
+ * range of dst-file and drains once, after all its chunks are copied.
+ *
+ * -m selects how src-file is read:
+ *	read - read() into a buffer of buffer-size bytes (4k by default),
+ *	       then copy the buffer to dst-file
+ *	mmap - map src-file and copy from the mapping directly to dst-file,
+ *	       so the data is copied only once
+ *	direct - like read, but src-file is opened with O_DIRECT, bypassing
+ *	       the page cache; buffer-size must be a multiple of 4k and
+ *	       chunk-size a multiple of buffer-size
+ *
+ * -u updates an existing dst-file instead of creating a new one. Each
+ * block of buffer-size bytes is compared with the destination and only
+ * the blocks which differ are written and flushed. The number of changed
+ * blocks is printed at the end.
+ *
+ * -s copies to pmem with the given strategy of copy_engine.c: default,
+ * nontemporal, temporal, avx2 or avx512. With -s auto the strategy for
+ * each transfer size is read from calibration-file (copy_engine.calib by
+ * default). If the file does not exist, the strategies are calibrated on
+ * a 16M scratch file, dst-file.calib, which is removed afterwards, and
+ * saved to calibration-file. If the scratch file is not pmem, the default
+ * strategy is used and nothing is saved.
+ *
+ * -k computes a CRC32C of every 4k block of src-file while copying it and
+ * stores the checksums in dst-file.crc: a header with the magic "CRC32C",
+ * the block size and the number of blocks, followed by one 32-bit checksum
+ * per block. Each block is checksummed right before it is copied, while it
+ * is still in the cache, so the data is not read a second time. chunk-size
+ * and buffer-size must be multiples of 4k.
+ *
+ * Throughput of the copy is printed at the end.
  */
 
+/* for O_DIRECT */
+#define _GNU_SOURCE
+
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <errno.h>
@@ -50,11 +92,46 @@
 #include <io.h>
 #endif
 #include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <pthread.h>
 #include <libpmem.h>
 
+#include "copy_engine.h"
+#include "crc32c.h"
+
 /* Copying 4K at a time to pmem for this example */
 #define BUF_LEN 4096
 
+/* Default size of a chunk copied by one thread in parallel mode */
+#define CHUNK_LEN (1 << 20)
+
+/* O_DIRECT requires aligned buffers, offsets and lengths */
+#define DIRECT_ALIGN 4096
+
+/* Where -s auto keeps the calibrated strategies */
+#define CALIB_FILE "copy_engine.calib"
+
+/* -k keeps one checksum per block of this many bytes */
+#define CRC_BLOCK 4096
+#define CRC_MAGIC "CRC32C"
+
+/*
+ * crc_header - start of the checksum file, followed by count checksums
+ */
+struct crc_header {
+	char magic[8];
+	uint32_t block_size;
+	uint32_t reserved;
+	uint64_t count;
+};
+
+enum copy_mode {
+	MODE_READ,
+	MODE_MMAP,
+	MODE_DIRECT,
+};
+
 /*
  * do_copy_to_pmem
  */
@@ -114,6 +191,328 @@ do_copy_to_non_pmem(char *addr, int srcfd, off_t len)
 	}
 }
 
+/*
+ * copy_thread - state of one thread of the parallel copy
+ */
+struct copy_thread {
+	pthread_t thread;
+	char *addr;
+	const char *src;	/* mapping of the source in mmap mode */
+	int srcfd;
+	off_t len;
+	size_t chunk;
+	size_t buf_len;
+	int direct;
+	unsigned idx;
+	unsigned nthreads;
+	int is_pmem;
+	int update;
+	size_t blocks;		/* blocks compared in update mode */
+	size_t changed;		/* blocks written in update mode */
+	uint32_t *crcs;		/* checksums of the blocks, or NULL */
+};
+
+/*
+ * checksum_block - compute the checksums of n bytes at offset off
+ */
+static void
+checksum_block(struct copy_thread *t, off_t off, const char *src, size_t n)
+{
+	size_t len;
+
+	for (; n > 0; off += len, src += len, n -= len) {
+		len = n < CRC_BLOCK ? n : CRC_BLOCK;
+		t->crcs[off / CRC_BLOCK] = crc32c(0, src, len);
+	}
+}
+
+/*
+ * copy_block - copy n bytes to offset off of the destination
+ */
+static void
+copy_block(struct copy_thread *t, off_t off, const char *src, size_t n)
+{
+	size_t len;
+
+	for (; n > 0; off += len, src += len, n -= len) {
+		len = n;
+
+		/* checksum the block, then copy it while it is cached */
+		if (t->crcs != NULL) {
+			len = n < CRC_BLOCK ? n : CRC_BLOCK;
+			t->crcs[off / CRC_BLOCK] = crc32c(0, src, len);
+		}
+
+		if (t->is_pmem)
+			copy_engine_memcpy_nodrain(t->addr + off, src, len);
+		else
+			memcpy(t->addr + off, src, len);
+	}
+}
+
+/*
+ * copy_range - copy n bytes to offset off of the destination,
+ *              in update mode only the blocks which differ
+ */
+static void
+copy_range(struct copy_thread *t, off_t off, const char *src, size_t n)
+{
+	size_t len;
+
+	if (!t->update) {
+		copy_block(t, off, src, n);
+		return;
+	}
+
+	for (; n > 0; off += len, src += len, n -= len) {
+		len = n < t->buf_len ? n : t->buf_len;
+		t->blocks++;
+
+		/* reading pmem is cheaper than writing it */
+		if (memcmp(t->addr + off, src, len) == 0) {
+			if (t->crcs != NULL)
+				checksum_block(t, off, src, len);
+			continue;
+		}
+
+		t->changed++;
+		copy_block(t, off, src, len);
+	}
+}
+
+/*
+ * copy_worker - copy chunks idx, idx + nthreads, ... of the file
+ */
+static void *
+copy_worker(void *arg)
+{
+	struct copy_thread *t = arg;
+	char *buf = NULL;
+	off_t chunk_off;
+	off_t off;
+	ssize_t cc;
+
+	if (t->src == NULL &&
+			(errno = posix_memalign((void **)&buf, DIRECT_ALIGN,
+				t->buf_len)) != 0) {
+		perror("posix_memalign");
+		exit(1);
+	}
+
+	for (chunk_off = (off_t)t->idx * t->chunk; chunk_off < t->len;
+			chunk_off += (off_t)t->nthreads * t->chunk) {
+		off_t end = chunk_off + (off_t)t->chunk;
+		if (end > t->len)
+			end = t->len;
+
+		/* The source is mapped, copy straight from it */
+		if (t->src != NULL) {
+			copy_range(t, chunk_off, t->src + chunk_off,
+				end - chunk_off);
+			continue;
+		}
+
+		for (off = chunk_off; off < end; off += cc) {
+			size_t n = (size_t)(end - off) < t->buf_len ?
+				(size_t)(end - off) : t->buf_len;
+			size_t req = n;
+
+			/* the tail of the file is read in whole blocks */
+			if (t->direct)
+				req = (n + DIRECT_ALIGN - 1) &
+					~(size_t)(DIRECT_ALIGN - 1);
+
+			if ((cc = pread(t->srcfd, buf, req, off)) <= 0) {
+				perror("pread");
+				exit(1);
+			}
+			if ((size_t)cc > n)
+				cc = n;
+
+			copy_range(t, off, buf, cc);
+		}
+	}
+
+	free(buf);
+
+	/* Each thread drains its own stores */
+	if (t->is_pmem)
+		pmem_drain();
+
+	return NULL;
+}
+
+/*
+ * do_parallel_copy - copy the file using nthreads threads
+ */
+static void
+do_parallel_copy(char *addr, int srcfd, off_t len, int is_pmem,
+		unsigned nthreads, size_t chunk, enum copy_mode mode,
+		size_t buf_len, int update, uint32_t *crcs)
+{
+	struct copy_thread *threads;
+	size_t blocks = 0;
+	size_t changed = 0;
+	char *src = NULL;
+	unsigned i;
+
+	if (mode == MODE_MMAP && len > 0) {
+		src = mmap(NULL, len, PROT_READ, MAP_PRIVATE, srcfd, 0);
+		if (src == MAP_FAILED) {
+			perror("mmap");
+			exit(1);
+		}
+
+		/* let the kernel read ahead aggressively */
+		if (madvise(src, len, MADV_SEQUENTIAL) < 0)
+			perror("madvise");
+	}
+
+	if ((threads = calloc(nthreads, sizeof(*threads))) == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		threads[i].addr = addr;
+		threads[i].src = src;
+		threads[i].srcfd = srcfd;
+		threads[i].len = len;
+		threads[i].chunk = chunk;
+		threads[i].buf_len = buf_len;
+		threads[i].direct = mode == MODE_DIRECT;
+		threads[i].idx = i;
+		threads[i].nthreads = nthreads;
+		threads[i].is_pmem = is_pmem;
+		threads[i].update = update;
+		threads[i].crcs = crcs;
+
+		errno = pthread_create(&threads[i].thread, NULL,
+				copy_worker, &threads[i]);
+		if (errno) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(threads[i].thread, NULL);
+		blocks += threads[i].blocks;
+		changed += threads[i].changed;
+	}
+
+	free(threads);
+
+	if (src != NULL)
+		munmap(src, len);
+
+	if (!is_pmem && pmem_msync(addr, len) < 0) {
+		perror("pmem_msync");
+		exit(1);
+	}
+
+	if (update)
+		printf("%zu of %zu blocks changed\n", changed, blocks);
+}
+
+/*
+ * persist_range - make a range of a file mapped by pmem_map_file durable
+ */
+static void
+persist_range(const void *addr, size_t len, int is_pmem)
+{
+	if (is_pmem)
+		pmem_persist(addr, len);
+	else if (pmem_msync(addr, len) < 0) {
+		perror("pmem_msync");
+		exit(1);
+	}
+}
+
+/*
+ * crc_map - map the checksum file for a file of len bytes
+ *
+ * The header is cleared first, so the file is not valid until
+ * crc_publish() is called, even if it is updated in place.
+ */
+static struct crc_header *
+crc_map(const char *path, off_t len, size_t *mapped_len, int *is_pmem)
+{
+	uint64_t count = ((uint64_t)len + CRC_BLOCK - 1) / CRC_BLOCK;
+	struct crc_header *hdr;
+
+	if ((hdr = pmem_map_file(path,
+			sizeof(*hdr) + count * sizeof(uint32_t),
+			PMEM_FILE_CREATE, 0666, mapped_len, is_pmem)) == NULL) {
+		perror(path);
+		exit(1);
+	}
+
+	memset(hdr, 0, sizeof(*hdr));
+	persist_range(hdr, sizeof(*hdr), *is_pmem);
+
+	return hdr;
+}
+
+/*
+ * crc_publish - persist the checksums, then the header which makes
+ *               them valid
+ */
+static void
+crc_publish(struct crc_header *hdr, off_t len, int is_pmem)
+{
+	uint64_t count = ((uint64_t)len + CRC_BLOCK - 1) / CRC_BLOCK;
+
+	persist_range(hdr + 1, count * sizeof(uint32_t), is_pmem);
+
+	hdr->block_size = CRC_BLOCK;
+	hdr->count = count;
+	memcpy(hdr->magic, CRC_MAGIC, sizeof(CRC_MAGIC));
+	persist_range(hdr, sizeof(*hdr), is_pmem);
+}
+
+/*
+ * parse_size - parse number of bytes with optional k, m or g suffix
+ */
+static size_t
+parse_size(const char *str)
+{
+	char *end;
+	unsigned long long size = strtoull(str, &end, 10);
+
+	switch (*end) {
+	case 'g': case 'G':
+		size <<= 10;
+		/* fallthrough */
+	case 'm': case 'M':
+		size <<= 10;
+		/* fallthrough */
+	case 'k': case 'K':
+		size <<= 10;
+		end++;
+		break;
+	}
+
+	if (*end != '\0' || size == 0) {
+		fprintf(stderr, "invalid size: %s\n", str);
+		exit(1);
+	}
+
+	return size;
+}
+
+static void
+usage(const char *progname)
+{
+	fprintf(stderr,
+		"usage: %s [-t threads] [-c chunk-size] "
+		"[-m read|mmap|direct] [-b buffer-size] [-u] "
+		"[-s strategy|auto] [-f calibration-file] [-k] "
+		"src-file dst-file\n",
+		progname);
+	exit(1);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -122,17 +521,97 @@ main(int argc, char *argv[])
 	char *pmemaddr;
 	size_t mapped_len;
 	int is_pmem;
+	unsigned nthreads = 0;
+	size_t chunk = CHUNK_LEN;
+	enum copy_mode mode = MODE_READ;
+	size_t buf_len = BUF_LEN;
+	int srcflags = O_RDONLY;
+	int dstflags = PMEM_FILE_CREATE|PMEM_FILE_EXCL;
+	int update = 0;
+	const char *strategy = NULL;
+	const char *calib_file = CALIB_FILE;
+	enum copy_strategy s = COPY_DEFAULT;
+	int checksum = 0;
+	char *crc_path = NULL;
+	struct crc_header *crc_hdr = NULL;
+	size_t crc_mapped_len = 0;
+	int crc_is_pmem = 0;
+	struct timespec start, stop;
+	double secs;
+	int opt;
 
-	if (argc != 3) {
-		fprintf(stderr, 
-			"usage: %s src-file dst-file\n", 
-			argv[0]);
+	while ((opt = getopt(argc, argv, "t:c:m:b:us:f:k")) != -1) {
+		switch (opt) {
+		case 't':
+			nthreads = (unsigned)strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			chunk = parse_size(optarg);
+			break;
+		case 'm':
+			if (strcmp(optarg, "read") == 0)
+				mode = MODE_READ;
+			else if (strcmp(optarg, "mmap") == 0)
+				mode = MODE_MMAP;
+			else if (strcmp(optarg, "direct") == 0)
+				mode = MODE_DIRECT;
+			else
+				usage(argv[0]);
+			break;
+		case 'b':
+			buf_len = parse_size(optarg);
+			break;
+		case 'u':
+			/* reuse the existing dst-file */
+			update = 1;
+			dstflags = PMEM_FILE_CREATE;
+			break;
+		case 's':
+			strategy = optarg;
+			if (strcmp(strategy, "auto") == 0)
+				break;
+			if (copy_strategy_parse(strategy, &s) < 0)
+				usage(argv[0]);
+			if (!copy_strategy_supported(s)) {
+				fprintf(stderr, "%s is not supported on this "
+					"CPU\n", strategy);
+				exit(1);
+			}
+			break;
+		case 'f':
+			calib_file = optarg;
+			break;
+		case 'k':
+			checksum = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (argc - optind != 2)
+		usage(argv[0]);
+
+	if (mode == MODE_DIRECT) {
+		if (buf_len % DIRECT_ALIGN || chunk % buf_len) {
+			fprintf(stderr, "direct mode requires buffer-size "
+				"to be a multiple of %d and chunk-size "
+				"a multiple of buffer-size\n", DIRECT_ALIGN);
+			exit(1);
+		}
+		srcflags |= O_DIRECT;
+	}
+
+	/* blocks are checksummed as a whole */
+	if (checksum && (buf_len % CRC_BLOCK || chunk % CRC_BLOCK)) {
+		fprintf(stderr, "-k requires buffer-size and chunk-size "
+			"to be multiples of %d\n", CRC_BLOCK);
 		exit(1);
 	}
 
 	/* Open src-file */
-	if ((srcfd = open(argv[1], O_RDONLY)) < 0) {
-		perror(argv[1]);
+	if ((srcfd = open(argv[optind], srcflags)) < 0) {
+		perror(argv[optind]);
 		exit(1);
 	}
 
@@ -142,28 +621,89 @@ main(int argc, char *argv[])
 		exit(1);
 	}
 
-	/* create a pmem file and memory map it */
-	if ((pmemaddr = pmem_map_file(argv[2], 
+	/* create (or open, in update mode) a pmem file and memory map it */
+	if ((pmemaddr = pmem_map_file(argv[optind + 1], 
 			stbuf.st_size, 
-			PMEM_FILE_CREATE|PMEM_FILE_EXCL,
+			dstflags,
 			0666, &mapped_len, &is_pmem)) == NULL) {
 		perror("pmem_map_file");
 		exit(1);
 	}
 
+	/* create (or reuse) dst-file.crc for the checksums */
+	if (checksum) {
+		crc32c_init();
+
+		if ((crc_path = malloc(strlen(argv[optind + 1]) + 5)) == NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		sprintf(crc_path, "%s.crc", argv[optind + 1]);
+		crc_hdr = crc_map(crc_path, stbuf.st_size,
+			&crc_mapped_len, &crc_is_pmem);
+	}
+
+	copy_engine_set(s);
+	if (strategy != NULL && strcmp(strategy, "auto") == 0 &&
+			copy_engine_load(calib_file) < 0) {
+		char *scratch_path;
+
+		if ((scratch_path = malloc(strlen(argv[optind + 1]) + 7))
+				== NULL) {
+			perror("malloc");
+			exit(1);
+		}
+		sprintf(scratch_path, "%s.calib", argv[optind + 1]);
+
+		printf("calibrating...\n");
+		if (copy_engine_calibrate(scratch_path) < 0) {
+			fprintf(stderr, "cannot calibrate, using the default "
+				"strategy\n");
+		} else {
+			copy_engine_print();
+			if (copy_engine_save(calib_file) < 0)
+				perror(calib_file);
+		}
+
+		free(scratch_path);
+	}
+
 	/* 
  	 * Determine if range is true pmem, 
  	 * call appropriate copy routine 
  	 * */
-	if (is_pmem)
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (nthreads > 0 || mode != MODE_READ || buf_len != BUF_LEN ||
+			update || strategy != NULL || checksum)
+		do_parallel_copy(pmemaddr, srcfd, stbuf.st_size,
+			is_pmem, nthreads > 0 ? nthreads : 1, chunk,
+			mode, buf_len, update,
+			checksum ? (uint32_t *)(crc_hdr + 1) : NULL);
+	else if (is_pmem)
 		do_copy_to_pmem(pmemaddr, srcfd, 
 			stbuf.st_size);
 	else
 		do_copy_to_non_pmem(pmemaddr, srcfd, 
 			stbuf.st_size);
 
+	if (checksum)
+		crc_publish(crc_hdr, stbuf.st_size, crc_is_pmem);
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	secs = (stop.tv_sec - start.tv_sec) +
+		(stop.tv_nsec - start.tv_nsec) / 1e9;
+	printf("copied %lld bytes in %.3f s (%.2f GB/s)\n",
+		(long long)stbuf.st_size, secs,
+		stbuf.st_size / secs / 1e9);
+
 	close(srcfd);
 	pmem_unmap(pmemaddr, mapped_len);
 
+	if (checksum) {
+		pmem_unmap(crc_hdr, crc_mapped_len);
+		free(crc_path);
+	}
+
 	exit(0);
 }
@@ -0,0 +1,446 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * uring_ingest.c - overlap reads of the source with pmem stores
+ *
+ * usage: uring_ingest [-d queue-depth] [-b block-size] [-w workers]
+ *		src-file dst-file
+ *
+ * Copies src-file to dst-file. The main thread keeps up to queue-depth
+ * reads of block-size bytes (64 and 1M by default) in flight using
+ * io_uring. Each completed block is handed to a pool of worker threads
+ * which copy it to dst-file with pmem_memcpy_nodrain, while the main
+ * thread submits a read for the next block. Each worker calls
+ * pmem_drain once, after it has copied all its blocks.
+ *
+ * Throughput of the copy is printed at the end.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <liburing.h>
+#include <libpmem.h>
+
+#define QUEUE_DEPTH 64
+#define BLOCK_LEN (1 << 20)
+#define NWORKERS 4
+
+/* buffers are page aligned */
+#define BUF_ALIGN 4096
+
+/*
+ * block - one buffer and the range of the file it holds
+ */
+struct block {
+	char *buf;
+	off_t off;
+	size_t len;
+	size_t done;		/* bytes read so far */
+};
+
+/*
+ * ingest - state shared by the main thread and the workers
+ *
+ * Blocks waiting to be copied are kept in the ready ring, blocks which
+ * can be reused for reading on the free stack. Both are protected by lock.
+ */
+struct ingest {
+	char *addr;
+	int is_pmem;
+	struct block *blocks;
+	unsigned depth;
+
+	pthread_mutex_t lock;
+	pthread_cond_t ready_cond;	/* signalled when a block is ready */
+	pthread_cond_t free_cond;	/* signalled when a block is freed */
+	struct block **ready;
+	unsigned ready_head;
+	unsigned ready_count;
+	struct block **free;
+	unsigned free_count;
+	int finished;			/* no more blocks will be read */
+};
+
+/*
+ * parse_size - parse a size with an optional k, m or g suffix
+ */
+static size_t
+parse_size(const char *str)
+{
+	char *end;
+	unsigned long long size = strtoull(str, &end, 10);
+
+	switch (*end) {
+	case 'g': case 'G':
+		size <<= 10;
+		/* fallthrough */
+	case 'm': case 'M':
+		size <<= 10;
+		/* fallthrough */
+	case 'k': case 'K':
+		size <<= 10;
+		end++;
+		break;
+	}
+
+	if (*end != '\0' || size == 0) {
+		fprintf(stderr, "invalid size: %s\n", str);
+		exit(1);
+	}
+
+	return size;
+}
+
+/*
+ * usage -- print usage message and exit
+ */
+static void
+usage(const char *progname)
+{
+	fprintf(stderr,
+		"usage: %s [-d queue-depth] [-b block-size] [-w workers] "
+		"src-file dst-file\n", progname);
+	exit(1);
+}
+
+/*
+ * ingest_worker - copy ready blocks to the destination until the
+ *                 main thread is finished and no blocks are left
+ */
+static void *
+ingest_worker(void *arg)
+{
+	struct ingest *in = arg;
+	struct block *b;
+
+	for (;;) {
+		pthread_mutex_lock(&in->lock);
+		while (in->ready_count == 0 && !in->finished)
+			pthread_cond_wait(&in->ready_cond, &in->lock);
+
+		if (in->ready_count == 0) {
+			pthread_mutex_unlock(&in->lock);
+			break;
+		}
+
+		b = in->ready[in->ready_head];
+		in->ready_head = (in->ready_head + 1) % in->depth;
+		in->ready_count--;
+		pthread_mutex_unlock(&in->lock);
+
+		if (in->is_pmem)
+			pmem_memcpy_nodrain(in->addr + b->off, b->buf, b->len);
+		else
+			memcpy(in->addr + b->off, b->buf, b->len);
+
+		pthread_mutex_lock(&in->lock);
+		in->free[in->free_count++] = b;
+		pthread_cond_signal(&in->free_cond);
+		pthread_mutex_unlock(&in->lock);
+	}
+
+	/* Perform final flush step for all the blocks of this worker */
+	if (in->is_pmem)
+		pmem_drain();
+
+	return NULL;
+}
+
+/*
+ * submit_read - queue a read of the rest of block b
+ */
+static void
+submit_read(struct io_uring *ring, int srcfd, struct block *b)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+
+	/* never happens, there are at most depth reads in flight */
+	if (sqe == NULL) {
+		fprintf(stderr, "submission queue full\n");
+		exit(1);
+	}
+
+	io_uring_prep_read(sqe, srcfd, b->buf + b->done,
+		(unsigned)(b->len - b->done), b->off + (off_t)b->done);
+	io_uring_sqe_set_data(sqe, b);
+}
+
+/*
+ * complete_read - handle one completion, pass the block to the workers
+ *                 once it is read in full
+ *
+ * Returns 1 if the block was resubmitted because of a short read.
+ */
+static int
+complete_read(struct io_uring *ring, int srcfd, struct ingest *in,
+		struct io_uring_cqe *cqe)
+{
+	struct block *b = io_uring_cqe_get_data(cqe);
+
+	if (cqe->res < 0) {
+		errno = -cqe->res;
+		perror("read");
+		exit(1);
+	}
+
+	if (cqe->res == 0) {
+		fprintf(stderr, "unexpected end of file\n");
+		exit(1);
+	}
+
+	b->done += (size_t)cqe->res;
+	if (b->done < b->len) {
+		submit_read(ring, srcfd, b);
+		return 1;
+	}
+
+	pthread_mutex_lock(&in->lock);
+	in->ready[(in->ready_head + in->ready_count) % in->depth] = b;
+	in->ready_count++;
+	pthread_cond_signal(&in->ready_cond);
+	pthread_mutex_unlock(&in->lock);
+
+	return 0;
+}
+
+/*
+ * do_ingest - read the file through io_uring, copy it on nworkers threads
+ */
+static void
+do_ingest(char *addr, int srcfd, off_t len, int is_pmem,
+		unsigned depth, size_t block_len, unsigned nworkers)
+{
+	struct io_uring ring;
+	struct io_uring_cqe *cqe;
+	struct ingest in;
+	pthread_t *workers;
+	struct block *b;
+	off_t next = 0;
+	unsigned inflight = 0;
+	unsigned i;
+	int ret;
+
+	if ((ret = io_uring_queue_init(depth, &ring, 0)) < 0) {
+		errno = -ret;
+		perror("io_uring_queue_init");
+		exit(1);
+	}
+
+	memset(&in, 0, sizeof(in));
+	in.addr = addr;
+	in.is_pmem = is_pmem;
+	in.depth = depth;
+	pthread_mutex_init(&in.lock, NULL);
+	pthread_cond_init(&in.ready_cond, NULL);
+	pthread_cond_init(&in.free_cond, NULL);
+
+	in.blocks = calloc(depth, sizeof(*in.blocks));
+	in.ready = calloc(depth, sizeof(*in.ready));
+	in.free = calloc(depth, sizeof(*in.free));
+	workers = calloc(nworkers, sizeof(*workers));
+	if (in.blocks == NULL || in.ready == NULL || in.free == NULL ||
+			workers == NULL) {
+		perror("calloc");
+		exit(1);
+	}
+
+	for (i = 0; i < depth; i++) {
+		if ((errno = posix_memalign((void **)&in.blocks[i].buf,
+				BUF_ALIGN, block_len)) != 0) {
+			perror("posix_memalign");
+			exit(1);
+		}
+		in.free[in.free_count++] = &in.blocks[i];
+	}
+
+	for (i = 0; i < nworkers; i++) {
+		errno = pthread_create(&workers[i], NULL, ingest_worker, &in);
+		if (errno) {
+			perror("pthread_create");
+			exit(1);
+		}
+	}
+
+	while (next < len || inflight > 0) {
+		/*
+		 * Queue a read into every free buffer. If all buffers are
+		 * being copied, wait until a worker is done with one.
+		 */
+		pthread_mutex_lock(&in.lock);
+		while (in.free_count == 0 && inflight == 0)
+			pthread_cond_wait(&in.free_cond, &in.lock);
+
+		while (in.free_count > 0 && next < len) {
+			b = in.free[--in.free_count];
+			b->off = next;
+			b->len = block_len;
+			if ((off_t)b->len > len - next)
+				b->len = (size_t)(len - next);
+			b->done = 0;
+			next += (off_t)b->len;
+
+			submit_read(&ring, srcfd, b);
+			inflight++;
+		}
+		pthread_mutex_unlock(&in.lock);
+
+		if (inflight == 0)
+			continue;
+
+		if ((ret = io_uring_submit(&ring)) < 0) {
+			errno = -ret;
+			perror("io_uring_submit");
+			exit(1);
+		}
+
+		/* wait for one read, then reap whatever else has completed */
+		if ((ret = io_uring_wait_cqe(&ring, &cqe)) < 0) {
+			errno = -ret;
+			perror("io_uring_wait_cqe");
+			exit(1);
+		}
+
+		do {
+			if (!complete_read(&ring, srcfd, &in, cqe))
+				inflight--;
+			io_uring_cqe_seen(&ring, cqe);
+		} while (io_uring_peek_cqe(&ring, &cqe) == 0);
+	}
+
+	pthread_mutex_lock(&in.lock);
+	in.finished = 1;
+	pthread_cond_broadcast(&in.ready_cond);
+	pthread_mutex_unlock(&in.lock);
+
+	for (i = 0; i < nworkers; i++)
+		pthread_join(workers[i], NULL);
+
+	io_uring_queue_exit(&ring);
+
+	for (i = 0; i < depth; i++)
+		free(in.blocks[i].buf);
+	free(in.blocks);
+	free(in.ready);
+	free(in.free);
+	free(workers);
+	pthread_cond_destroy(&in.free_cond);
+	pthread_cond_destroy(&in.ready_cond);
+	pthread_mutex_destroy(&in.lock);
+
+	/* Flush it */
+	if (!is_pmem && pmem_msync(addr, len) < 0) {
+		perror("pmem_msync");
+		exit(1);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	int srcfd;
+	struct stat stbuf;
+	char *pmemaddr;
+	size_t mapped_len;
+	int is_pmem;
+	unsigned depth = QUEUE_DEPTH;
+	size_t block_len = BLOCK_LEN;
+	unsigned nworkers = NWORKERS;
+	struct timespec start, stop;
+	double secs;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:b:w:")) != -1) {
+		switch (opt) {
+		case 'd':
+			depth = (unsigned)strtoul(optarg, NULL, 10);
+			break;
+		case 'b':
+			block_len = parse_size(optarg);
+			break;
+		case 'w':
+			nworkers = (unsigned)strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (argc - optind != 2 || depth == 0 || nworkers == 0)
+		usage(argv[0]);
+
+	/* Open src-file */
+	if ((srcfd = open(argv[optind], O_RDONLY)) < 0) {
+		perror(argv[optind]);
+		exit(1);
+	}
+
+	/* Find the size of the src-file */
+	if (fstat(srcfd, &stbuf) < 0) {
+		perror("fstat");
+		exit(1);
+	}
+
+	/* create a pmem file and memory map it */
+	if ((pmemaddr = pmem_map_file(argv[optind + 1],
+			stbuf.st_size,
+			PMEM_FILE_CREATE|PMEM_FILE_EXCL,
+			0666, &mapped_len, &is_pmem)) == NULL) {
+		perror("pmem_map_file");
+		exit(1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	do_ingest(pmemaddr, srcfd, stbuf.st_size, is_pmem,
+		depth, block_len, nworkers);
+
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	secs = (stop.tv_sec - start.tv_sec) +
+		(stop.tv_nsec - start.tv_nsec) / 1e9;
+	printf("copied %lld bytes in %.3f s (%.2f GB/s)\n",
+		(long long)stbuf.st_size, secs,
+		stbuf.st_size / secs / 1e9);
+
+	close(srcfd);
+	pmem_unmap(pmemaddr, mapped_len);
+
+	exit(0);
+}
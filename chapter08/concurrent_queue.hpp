@@ -0,0 +1,223 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * concurrent_queue.hpp -- bounded multi-producer multi-consumer persistent
+ * queue. Slots are allocated once, when the queue is created. Producers and
+ * consumers claim positions by advancing tail and head with compare and
+ * swap and hand slots over through a sequence number stored in each slot,
+ * so push and pop use no transactions and no locks.
+ *
+ * The slot for position pos holds seq == pos while it is empty and
+ * seq == pos + 1 once the element is written. A consumer sets seq to
+ * pos + capacity, which makes the slot available for the next lap.
+ * Element is persisted before seq, so every slot whose persisted seq says
+ * it is full holds a valid element.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+struct alignas(64) concurrent_queue_slot {
+	std::atomic<uint64_t> seq;
+	int value;
+
+	/* set by recovery in slots which must be skipped by consumers */
+	int skip;
+};
+
+struct concurrent_queue {
+	/* allocates capacity slots, capacity must be a power of two */
+	void
+	create(pmem::obj::pool_base &pop, uint64_t capacity)
+	{
+		if (capacity < 2 || (capacity & (capacity - 1)) != 0)
+			throw std::invalid_argument(
+				"capacity must be a power of two");
+
+		pmem::obj::transaction::run(pop, [&]{
+			slots = pmem::obj::make_persistent<
+				concurrent_queue_slot[]>(capacity);
+			this->capacity = capacity;
+
+			for (uint64_t i = 0; i < capacity; i++) {
+				slots[i].seq.store(i, std::memory_order_relaxed);
+				slots[i].skip = 0;
+			}
+		});
+
+		head.store(0);
+		tail.store(0);
+	}
+
+	bool
+	created() const
+	{
+		return slots != nullptr;
+	}
+
+	/*
+	 * Finds head and tail after the pool is opened, must be called before
+	 * any push or pop. Positions between head and tail which do not hold
+	 * an element (claimed by a producer which did not finish, or already
+	 * consumed while an earlier element was not) are marked to be skipped.
+	 * Elements taken by consumers which did not finish are delivered
+	 * again.
+	 */
+	void
+	recover(pmem::obj::pool_base &pop)
+	{
+		uint64_t mask = capacity - 1;
+		uint64_t first = UINT64_MAX, last = 0, empty = UINT64_MAX;
+
+		for (uint64_t i = 0; i < capacity; i++) {
+			uint64_t seq = slots[i].seq.load(std::memory_order_relaxed);
+			if (((seq - 1 - i) & mask) == 0) {
+				first = std::min(first, seq - 1);
+				last = std::max(last, seq);
+			} else {
+				empty = std::min(empty, seq);
+			}
+		}
+
+		if (first == UINT64_MAX) {
+			head.store(empty);
+			tail.store(empty);
+			return;
+		}
+
+		for (uint64_t pos = first; pos < last; pos++) {
+			auto &slot = slots[pos & mask];
+			if (slot.seq.load(std::memory_order_relaxed) == pos + 1)
+				continue;
+
+			slot.skip = 1;
+			pop.persist(&slot.skip, sizeof(slot.skip));
+			slot.seq.store(pos + 1, std::memory_order_relaxed);
+			pop.persist(&slot.seq, sizeof(slot.seq));
+		}
+
+		head.store(first);
+		tail.store(last);
+	}
+
+	/* returns false if the queue is full */
+	bool
+	try_push(pmem::obj::pool_base &pop, int value)
+	{
+		uint64_t mask = capacity - 1;
+		uint64_t pos = tail.load(std::memory_order_relaxed);
+
+		for (;;) {
+			auto seq = slots[pos & mask].seq.load(
+				std::memory_order_acquire);
+			auto diff = static_cast<int64_t>(seq - pos);
+
+			if (diff == 0) {
+				if (tail.compare_exchange_weak(pos, pos + 1,
+						std::memory_order_relaxed))
+					break;
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		auto &slot = slots[pos & mask];
+		slot.value = value;
+		slot.skip = 0;
+		pop.flush(&slot.value, sizeof(slot.value));
+		pop.flush(&slot.skip, sizeof(slot.skip));
+		pop.drain();
+
+		slot.seq.store(pos + 1, std::memory_order_release);
+		pop.persist(&slot.seq, sizeof(slot.seq));
+
+		return true;
+	}
+
+	/* returns false if the queue is empty */
+	bool
+	try_pop(pmem::obj::pool_base &pop, int &value)
+	{
+		uint64_t mask = capacity - 1;
+
+		for (;;) {
+			uint64_t pos = head.load(std::memory_order_relaxed);
+
+			for (;;) {
+				auto seq = slots[pos & mask].seq.load(
+					std::memory_order_acquire);
+				auto diff = static_cast<int64_t>(seq - (pos + 1));
+
+				if (diff == 0) {
+					if (head.compare_exchange_weak(pos,
+							pos + 1,
+							std::memory_order_relaxed))
+						break;
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = head.load(
+						std::memory_order_relaxed);
+				}
+			}
+
+			auto &slot = slots[pos & mask];
+			bool skip = slot.skip != 0;
+			value = slot.value;
+
+			slot.seq.store(pos + capacity, std::memory_order_release);
+			pop.persist(&slot.seq, sizeof(slot.seq));
+
+			if (!skip)
+				return true;
+		}
+	}
+
+private:
+	pmem::obj::persistent_ptr<concurrent_queue_slot[]> slots = nullptr;
+	pmem::obj::p<uint64_t> capacity = 0;
+
+	/* not persisted, recomputed by recover() */
+	alignas(64) std::atomic<uint64_t> head;
+	alignas(64) std::atomic<uint64_t> tail;
+};
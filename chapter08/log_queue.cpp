@@ -0,0 +1,104 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * log_queue.cpp -- example usage of log_queue with a given number of
+ * consumer groups, each of which reads every appended message.
+ *
+ * create the pool for this program using pmempool, for example:
+ *	pmempool create obj --layout=log_queue -s 100M log_queue_pool
+ */
+
+#include <iostream>
+#include <string>
+
+#include "log_queue.hpp"
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " path_to_pool [groups]" << std::endl;
+		return 1;
+	}
+
+	auto path = argv[1];
+	std::size_t groups = argc > 2 ? std::stoul(argv[2]) : 2;
+	pmem::obj::pool<log_queue<int>> pool;
+
+	try {
+		pool = pmem::obj::pool<log_queue<int>>::open(path, "log_queue");
+	} catch(pmem::pool_error &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr << "To create pool run: pmempool create obj --layout=log_queue -s 100M path_to_pool" << std::endl;
+		return 1;
+	}
+
+	auto q = pool.root();
+	if (!q->created())
+		q->create(pool, groups);
+
+	std::cout << q->group_count() << " consumer groups" << std::endl;
+
+	while (1) {
+		std::cout << "[append value|read group|exit]" << std::endl;
+
+		std::string command;
+		if (!(std::cin >> command))
+			break;
+
+		if (command == "append") {
+			int value;
+			std::cin >> value;
+
+			q->append(pool, value);
+		} else if (command == "read") {
+			std::size_t group;
+			std::cin >> group;
+
+			int value;
+			if (q->read(pool, group, value))
+				std::cout << value << std::endl;
+			else
+				std::cout << "no new messages" << std::endl;
+		} else if (command == "exit") {
+			break;
+		} else {
+			std::cerr << "unknown ops" << std::endl;
+			break;
+		}
+	}
+
+	pool.close();
+
+	return 0;
+}
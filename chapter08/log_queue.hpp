@@ -0,0 +1,247 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * log_queue.hpp -- persistent queue which keeps messages after they are
+ * read. Every consumer group has its own persistent cursor, so each group
+ * sees every message while the message is written only once. Messages are
+ * stored in fixed-size segments, a segment is freed when cursors of all
+ * groups have moved past it.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/mutex.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+template <typename T, std::size_t SegmentSize>
+struct log_segment {
+	log_segment(uint64_t first) : first(first), next(nullptr)
+	{
+	}
+
+	/* position of entries[0] in the log */
+	pmem::obj::p<uint64_t> first;
+	pmem::obj::persistent_ptr<log_segment> next;
+	T entries[SegmentSize];
+};
+
+/**
+ * T - type of messages, must be trivially copyable
+ * SegmentSize - number of messages in one segment
+ */
+template <typename T, std::size_t SegmentSize = 1024>
+struct log_queue {
+	static_assert(std::is_trivially_copyable<T>::value,
+		      "messages are written without a transaction");
+
+	static const std::size_t max_groups = 16;
+
+	using segment_type = log_segment<T, SegmentSize>;
+
+	void
+	create(pmem::obj::pool_base &pop, std::size_t groups)
+	{
+		if (groups == 0 || groups > max_groups)
+			throw std::invalid_argument("invalid number of groups");
+
+		pmem::obj::transaction::run(pop, [&]{
+			head = tail = pmem::obj::make_persistent<segment_type>(0);
+			this->groups = groups;
+		});
+
+		end.store(0);
+		pop.persist(&end, sizeof(end));
+		for (std::size_t i = 0; i < max_groups; i++)
+			cursors[i].store(0);
+		pop.persist(cursors, sizeof(cursors));
+	}
+
+	bool
+	created() const
+	{
+		return head != nullptr;
+	}
+
+	std::size_t
+	group_count() const
+	{
+		return groups;
+	}
+
+	/* message becomes visible to consumers when end is persisted */
+	void
+	append(pmem::obj::pool_base &pop, const T &value)
+	{
+		std::unique_lock<pmem::obj::mutex> lock(mtx);
+
+		uint64_t pos = end.load(std::memory_order_relaxed);
+
+		if (pos - tail->first == SegmentSize) {
+			pmem::obj::transaction::run(pop, [&]{
+				auto segment =
+					pmem::obj::make_persistent<segment_type>(
+						pos);
+				tail->next = segment;
+				tail = segment;
+			});
+		}
+
+		auto &entry = tail->entries[pos - tail->first];
+		entry = value;
+		pop.persist(&entry, sizeof(entry));
+
+		/* release makes the entry and the link to its segment visible
+		 * to readers which acquire end */
+		end.store(pos + 1, std::memory_order_release);
+		pop.persist(&end, sizeof(end));
+	}
+
+	/* reads the next message for group, returns false if the group has
+	 * already read all of them */
+	bool
+	read(pmem::obj::pool_base &pop, std::size_t group, T &value)
+	{
+		return read_n(pop, group, &value, 1) == 1;
+	}
+
+	/* reads up to max next messages for group, the cursor is persisted
+	 * once for all of them. Groups read in parallel and do not block
+	 * appends, the queue mutex is taken only to find the first segment
+	 * and to free segments all groups have read. */
+	template <typename OutputIt>
+	std::size_t
+	read_n(pmem::obj::pool_base &pop, std::size_t group, OutputIt out,
+	       std::size_t max)
+	{
+		if (group >= groups)
+			throw std::out_of_range("no such group");
+
+		std::unique_lock<pmem::obj::mutex> group_lock(
+			group_mtx[group]);
+
+		uint64_t first = cursors[group].load(std::memory_order_relaxed);
+		uint64_t last = std::min<uint64_t>(
+			end.load(std::memory_order_acquire), first + max);
+		if (first >= last)
+			return 0;
+
+		/* append may not have persisted end read above yet, the
+		 * cursor must never be durable past durable end */
+		pop.persist(&end, sizeof(end));
+
+		/* segments before the cursor may be freed by other groups,
+		 * so they are walked under the queue mutex. The segment
+		 * holding the cursor and the following ones stay until this
+		 * group moves its cursor. */
+		pmem::obj::persistent_ptr<segment_type> segment;
+		{
+			std::unique_lock<pmem::obj::mutex> lock(mtx);
+
+			segment = head;
+			while (segment->first + SegmentSize <= first)
+				segment = segment->next;
+		}
+
+		for (auto pos = first; pos < last; pos++) {
+			if (pos - segment->first == SegmentSize)
+				segment = segment->next;
+			*out++ = segment->entries[pos - segment->first];
+		}
+
+		/* release keeps reads of the messages before the segments
+		 * can be freed by reclaim */
+		cursors[group].store(last, std::memory_order_release);
+		pop.persist(&cursors[group], sizeof(cursors[group]));
+
+		group_lock.unlock();
+
+		reclaim(pop);
+
+		return last - first;
+	}
+
+private:
+	/* frees segments which all groups have read */
+	void
+	reclaim(pmem::obj::pool_base &pop)
+	{
+		std::unique_lock<pmem::obj::mutex> lock(mtx);
+
+		uint64_t min = UINT64_MAX;
+		for (std::size_t i = 0; i < groups; i++)
+			min = std::min<uint64_t>(
+				min, cursors[i].load(std::memory_order_acquire));
+
+		if (head == tail || head->first + SegmentSize > min)
+			return;
+
+		/* another group may not have persisted the cursor read above
+		 * yet, flushing them all makes sure no cursor goes back to
+		 * a freed segment after a crash */
+		pop.persist(cursors, sizeof(cursors));
+
+		while (head != tail && head->first + SegmentSize <= min) {
+			pmem::obj::transaction::run(pop, [&]{
+				auto segment = head;
+				head = head->next;
+				pmem::obj::delete_persistent<segment_type>(
+					segment);
+			});
+		}
+	}
+
+	pmem::obj::persistent_ptr<segment_type> head = nullptr;
+	pmem::obj::persistent_ptr<segment_type> tail = nullptr;
+
+	/* position one past the last message, written only by append */
+	std::atomic<uint64_t> end;
+
+	pmem::obj::p<std::size_t> groups = 0;
+	std::atomic<uint64_t> cursors[max_groups];
+
+	/* serializes appends with changes of head, reset on every pool
+	 * open */
+	pmem::obj::mutex mtx;
+
+	/* serializes reads of each group, reset on every pool open */
+	pmem::obj::mutex group_mtx[max_groups];
+};
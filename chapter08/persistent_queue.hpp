@@ -30,10 +30,13 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <libpmemobj++/make_persistent.hpp>
 #include <libpmemobj++/p.hpp>
@@ -41,19 +44,39 @@
 #include <libpmemobj++/pool.hpp>
 #include <libpmemobj++/transaction.hpp>
 
+/*
+ * Node holds the payload directly. A payload which fits in the node, like
+ * a small pmem::obj::string using its inline buffer, needs no allocation
+ * besides the node itself, larger ones allocate their data once.
+ */
+template <typename T>
 struct queue_node {
-	pmem::obj::p<int> value;
+	template <typename... Args>
+	queue_node(Args &&... args)
+	    : value(std::forward<Args>(args)...), next(nullptr)
+	{
+	}
+
+	T value;
 	pmem::obj::persistent_ptr<queue_node> next;
 };
 
+template <typename T>
 struct queue {
 	void
-	push(pmem::obj::pool_base &pop, int value)
+	push(pmem::obj::pool_base &pop, const T &value)
+	{
+		emplace(pop, value);
+	}
+
+	/* constructs the payload directly in the new node from args */
+	template <typename... Args>
+	void
+	emplace(pmem::obj::pool_base &pop, Args &&... args)
 	{
 		pmem::obj::transaction::run(pop, [&]{
-			auto node = pmem::obj::make_persistent<queue_node>();
-			node->value = value;
-			node->next = nullptr;
+			auto node = pmem::obj::make_persistent<queue_node<T>>(
+				std::forward<Args>(args)...);
 
 			if (head == nullptr) {
 				head = tail = node;
@@ -64,25 +87,92 @@ struct queue {
 		});
 	}
 
-	int
+	/* pushes values from [first, last) in one transaction, the nodes are
+	 * linked into a chain which is attached to the queue at once */
+	template <typename InputIt>
+	void
+	push_n(pmem::obj::pool_base &pop, InputIt first, InputIt last)
+	{
+		if (first == last)
+			return;
+
+		pmem::obj::transaction::run(pop, [&]{
+			auto chain_head =
+				pmem::obj::make_persistent<queue_node<T>>(*first);
+
+			auto chain_tail = chain_head;
+			for (++first; first != last; ++first) {
+				auto node = pmem::obj::make_persistent<
+					queue_node<T>>(*first);
+
+				chain_tail->next = node;
+				chain_tail = node;
+			}
+
+			if (head == nullptr)
+				head = chain_head;
+			else
+				tail->next = chain_head;
+
+			tail = chain_tail;
+		});
+	}
+
+	T
 	pop(pmem::obj::pool_base &pop)
 	{
-		int value;
+		T value;
+		this->pop(pop, [&](const T &v) { value = v; });
+
+		return value;
+	}
+
+	/* passes the first payload to f and removes it, in one transaction,
+	 * so that payloads which cannot be copied out of persistent memory
+	 * can be consumed in place */
+	template <typename F>
+	void
+	pop(pmem::obj::pool_base &pop, F f)
+	{
 		pmem::obj::transaction::run(pop, [&]{
 			if (head == nullptr)
 				throw std::out_of_range("no elements");
 
 			auto head_ptr = head;
-			value = head->value;
+			f(static_cast<const T &>(head->value));
 
 			head = head->next;
-			pmem::obj::delete_persistent<queue_node>(head_ptr);
+			pmem::obj::delete_persistent<queue_node<T>>(head_ptr);
 
 			if (head == nullptr)
 				tail = nullptr;
 		});
+	}
 
-		return value;
+	/* pops up to max values in one transaction and writes them to out,
+	 * returns the number of popped values */
+	template <typename OutputIt>
+	std::size_t
+	pop_n(pmem::obj::pool_base &pop, OutputIt out, std::size_t max)
+	{
+		std::vector<T> values;
+		pmem::obj::transaction::run(pop, [&]{
+			while (values.size() < max && head != nullptr) {
+				auto head_ptr = head;
+				values.push_back(head->value);
+
+				head = head->next;
+				pmem::obj::delete_persistent<queue_node<T>>(
+					head_ptr);
+			}
+
+			if (head == nullptr)
+				tail = nullptr;
+		});
+
+		std::copy(values.begin(), values.end(), out);
+
+		return values.size();
 	}
 
 	void
@@ -98,6 +188,6 @@ struct queue {
 	}
 
 private:
-	pmem::obj::persistent_ptr<queue_node> head = nullptr;
-	pmem::obj::persistent_ptr<queue_node> tail = nullptr;
+	pmem::obj::persistent_ptr<queue_node<T>> head = nullptr;
+	pmem::obj::persistent_ptr<queue_node<T>> tail = nullptr;
 };
@@ -40,13 +40,15 @@
 
 enum queue_op {
 	PUSH,
+	PUSHN,
 	POP,
+	POPN,
 	SHOW,
 	EXIT,
 	MAX_OPS,
 };
 
-const char *ops_str[MAX_OPS] = {"push", "pop", "show", "exit"};
+const char *ops_str[MAX_OPS] = {"push", "pushn", "pop", "popn", "show", "exit"};
 
 queue_op
 parse_queue_ops(const std::string &ops)
@@ -68,10 +70,10 @@ main(int argc, char *argv[])
 	}
 
 	auto path = argv[1];
-	pmem::obj::pool<queue> pool;
+	pmem::obj::pool<queue<int>> pool;
 
 	try {
-		pool = pmem::obj::pool<queue>::open(path, "queue");
+		pool = pmem::obj::pool<queue<int>>::open(path, "queue");
 	} catch(pmem::pool_error &e) {
 		std::cerr << e.what() << std::endl;
 		std::cerr << "To create pool run: pmempool create obj --layout=queue -s 100M path_to_pool" << std::endl;
@@ -80,7 +82,7 @@ main(int argc, char *argv[])
 	auto q = pool.root();
 
 	while (1) {
-		std::cout << "[push value|pop|show|exit]" << std::endl;
+		std::cout << "[push value|pushn count value|pop|popn count|show|exit]" << std::endl;
 
 		std::string command;
 		std::cin >> command;
@@ -97,10 +99,30 @@ main(int argc, char *argv[])
 
 				break;
 			}
+			case PUSHN: {
+				std::size_t count;
+				int value;
+				std::cin >> count >> value;
+
+				std::vector<int> values(count, value);
+				q->push_n(pool, values.begin(), values.end());
+
+				break;
+			}
 			case POP: {
 				std::cout << q->pop(pool) << std::endl;
 				break;
 			}
+			case POPN: {
+				std::size_t count;
+				std::cin >> count;
+
+				std::vector<int> values;
+				q->pop_n(pool, std::back_inserter(values), count);
+				for (auto value : values)
+					std::cout << value << std::endl;
+				break;
+			}
 			case SHOW: {
 				q->show();
 				break;
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * queue_bench.cpp -- compares throughput of the transactional queue from
+ * persistent_queue.hpp, protected by a mutex, with concurrent_queue.
+ * For every thread count the same number of producer and consumer threads
+ * is started, each producer pushes and each consumer pops ops elements.
+ *
+ * create the pool for this program using pmempool, for example:
+ *	pmempool create obj --layout=queue_bench -s 1G queue_bench_pool
+ */
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "concurrent_queue.hpp"
+#include "persistent_queue.hpp"
+
+struct root {
+	queue<int> q;
+	concurrent_queue cq;
+};
+
+/* runs threads producers and threads consumers, returns operations per
+ * second */
+template <typename Push, typename Pop>
+double
+run(unsigned threads, unsigned ops, Push push, Pop pop)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < threads; t++) {
+		workers.emplace_back([&, t]{
+			for (unsigned i = 0; i < ops; i++)
+				while (!push(static_cast<int>(t * ops + i)))
+					std::this_thread::yield();
+		});
+		workers.emplace_back([&]{
+			for (unsigned i = 0; i < ops; i++)
+				while (!pop())
+					std::this_thread::yield();
+		});
+	}
+
+	for (auto &w : workers)
+		w.join();
+
+	std::chrono::duration<double> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	return 2.0 * threads * ops / elapsed.count();
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0]
+			  << " path_to_pool [max_threads] [ops_per_thread]"
+			  << std::endl;
+		return 1;
+	}
+
+	auto path = argv[1];
+	unsigned max_threads = argc > 2 ? std::stoul(argv[2]) : 32;
+	unsigned ops = argc > 3 ? std::stoul(argv[3]) : 100000;
+
+	pmem::obj::pool<root> pool;
+
+	try {
+		pool = pmem::obj::pool<root>::open(path, "queue_bench");
+	} catch(pmem::pool_error &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr << "To create pool run: pmempool create obj --layout=queue_bench -s 1G path_to_pool" << std::endl;
+		return 1;
+	}
+
+	auto r = pool.root();
+
+	if (!r->cq.created())
+		r->cq.create(pool, 1 << 16);
+	r->cq.recover(pool);
+
+	std::mutex q_mutex;
+
+	for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+		auto q_ops = run(threads, ops,
+			[&](int value) -> bool {
+				std::lock_guard<std::mutex> lock(q_mutex);
+				r->q.push(pool, value);
+				return true;
+			},
+			[&]() -> bool {
+				std::lock_guard<std::mutex> lock(q_mutex);
+				try {
+					r->q.pop(pool);
+				} catch (std::out_of_range &) {
+					return false;
+				}
+				return true;
+			});
+
+		auto cq_ops = run(threads, ops,
+			[&](int value) {
+				return r->cq.try_push(pool, value);
+			},
+			[&]() -> bool {
+				int value;
+				return r->cq.try_pop(pool, value);
+			});
+
+		std::cout << threads << " producers/consumers: queue "
+			  << q_ops << " ops/s, concurrent_queue " << cq_ops
+			  << " ops/s" << std::endl;
+	}
+
+	pool.close();
+
+	return 0;
+}
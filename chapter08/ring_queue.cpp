@@ -0,0 +1,115 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * ring_queue.cpp -- example usage of ring_queue. "pushn count value" pushes
+ * count copies of value and "popn count" pops up to count elements, each
+ * as one batch.
+ *
+ * create the pool for this program using pmempool, for example:
+ *	pmempool create obj --layout=ring_queue -s 100M ring_queue_pool
+ */
+
+#include <string>
+#include <vector>
+
+#include "ring_queue.hpp"
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " path_to_pool [capacity]" << std::endl;
+		return 1;
+	}
+
+	auto path = argv[1];
+	uint64_t capacity = argc > 2 ? std::stoull(argv[2]) : 1024;
+	pmem::obj::pool<ring_queue> pool;
+
+	try {
+		pool = pmem::obj::pool<ring_queue>::open(path, "ring_queue");
+	} catch(pmem::pool_error &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr << "To create pool run: pmempool create obj --layout=ring_queue -s 100M path_to_pool" << std::endl;
+		return 1;
+	}
+
+	auto q = pool.root();
+	if (!q->created())
+		q->create(pool, capacity);
+
+	while (1) {
+		std::cout << "[push value|pushn count value|pop|popn count|show|exit]" << std::endl;
+
+		std::string command;
+		if (!(std::cin >> command))
+			break;
+
+		if (command == "push") {
+			int value;
+			std::cin >> value;
+
+			q->push(pool, value);
+		} else if (command == "pushn") {
+			uint64_t count;
+			int value;
+			std::cin >> count >> value;
+
+			std::vector<int> values(count, value);
+			std::cout << "pushed "
+				  << q->push_batch(pool, values.data(), count)
+				  << std::endl;
+		} else if (command == "pop") {
+			std::cout << q->pop(pool) << std::endl;
+		} else if (command == "popn") {
+			uint64_t count;
+			std::cin >> count;
+
+			std::vector<int> values(count);
+			auto n = q->pop_batch(pool, values.data(), count);
+			for (uint64_t i = 0; i < n; i++)
+				std::cout << values[i] << std::endl;
+		} else if (command == "show") {
+			q->show();
+		} else if (command == "exit") {
+			break;
+		} else {
+			std::cerr << "unknown ops" << std::endl;
+			break;
+		}
+	}
+
+	pool.close();
+
+	return 0;
+}
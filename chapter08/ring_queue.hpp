@@ -0,0 +1,151 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * ring_queue.hpp -- fixed capacity persistent queue stored in one array of
+ * slots. Elements are written to slots past tail and become visible when
+ * tail, a single 8-byte value, is persisted, so no transaction and no
+ * allocation is needed per element. A batch of elements is flushed with
+ * one drain.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+
+#include <libpmemobj++/make_persistent_array.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+
+struct ring_queue {
+	void
+	create(pmem::obj::pool_base &pop, uint64_t capacity)
+	{
+		pmem::obj::transaction::run(pop, [&]{
+			slots = pmem::obj::make_persistent<int[]>(capacity);
+			this->capacity = capacity;
+			head = 0;
+			tail = 0;
+		});
+	}
+
+	bool
+	created() const
+	{
+		return slots != nullptr;
+	}
+
+	uint64_t
+	size() const
+	{
+		return tail - head;
+	}
+
+	void
+	push(pmem::obj::pool_base &pop, int value)
+	{
+		if (push_batch(pop, &value, 1) == 0)
+			throw std::out_of_range("queue is full");
+	}
+
+	/* pushes as many of n values as fit, returns their number */
+	uint64_t
+	push_batch(pmem::obj::pool_base &pop, const int *values, uint64_t n)
+	{
+		n = std::min(n, capacity - size());
+
+		/* the run of slots may wrap around the end of the array */
+		uint64_t pos = tail % capacity;
+		uint64_t first = std::min(n, capacity - pos);
+
+		std::copy(values, values + first, &slots[pos]);
+		std::copy(values + first, values + n, &slots[0]);
+
+		pop.flush(&slots[pos], first * sizeof(int));
+		pop.flush(&slots[0], (n - first) * sizeof(int));
+		pop.drain();
+
+		tail = tail + n;
+		pop.persist(tail);
+
+		return n;
+	}
+
+	int
+	pop(pmem::obj::pool_base &pop)
+	{
+		int value;
+		if (pop_batch(pop, &value, 1) == 0)
+			throw std::out_of_range("no elements");
+
+		return value;
+	}
+
+	/* pops at most max values to out, returns their number */
+	uint64_t
+	pop_batch(pmem::obj::pool_base &pop, int *out, uint64_t max)
+	{
+		uint64_t n = std::min(max, size());
+
+		uint64_t pos = head % capacity;
+		uint64_t first = std::min(n, capacity - pos);
+
+		std::copy(&slots[pos], &slots[pos] + first, out);
+		std::copy(&slots[0], &slots[0] + (n - first), out + first);
+
+		head = head + n;
+		pop.persist(head);
+
+		return n;
+	}
+
+	void
+	show()
+	{
+		for (uint64_t i = head; i < tail; i++)
+			std::cout << "show: " << slots[i % capacity] << std::endl;
+
+		std::cout << std::endl;
+	}
+
+private:
+	pmem::obj::persistent_ptr<int[]> slots = nullptr;
+	pmem::obj::p<uint64_t> capacity = 0;
+
+	/* positions of the first and one past the last element, they only
+	 * grow, slot of position i is i % capacity */
+	pmem::obj::p<uint64_t> head = 0;
+	pmem::obj::p<uint64_t> tail = 0;
+};
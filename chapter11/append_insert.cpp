@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Alternative to versioning_insert.cpp: entries of a leaf are not kept
+ * sorted on persistent memory. A new entry is written to a free slot and
+ * becomes visible when the 8-byte validity bitmap is updated, which is
+ * failure atomic. Only one entry and the bitmap are flushed per insert.
+ * Entries are sorted in DRAM when the leaf is read. */
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "libpmemobj++/pool.hpp"
+#include "libpmemobj++/persistent_ptr.hpp"
+
+template <typename Value, uint64_t slots>
+class array {
+public:
+	static_assert(slots <= 64, "bitmap holds at most 64 slots");
+
+	void insert(pmem::obj::pool_base &pop, const Value &entry);
+	void remove(pmem::obj::pool_base &pop, const Value &entry);
+	std::vector<Value> sorted() const;
+
+	/* bit i is set if entries[i] is valid */
+	uint64_t bitmap;
+	Value entries[slots];
+};
+
+template <typename Value, uint64_t slots>
+void array<Value, slots>::insert(pmem::obj::pool_base &pop,
+				 const Value &entry) {
+	uint64_t free_slots = ~bitmap;
+	if (slots < 64)
+		free_slots &= (1ULL << slots) - 1;
+	if (free_slots == 0)
+		throw std::length_error("array is full");
+
+	auto slot = __builtin_ctzll(free_slots);
+
+	/* the slot is not valid yet, so it can be written in place */
+	entries[slot] = entry;
+	pop.persist(&entries[slot], sizeof(Value));
+
+	bitmap |= 1ULL << slot;
+	pop.persist(&bitmap, sizeof(bitmap));
+}
+
+template <typename Value, uint64_t slots>
+void array<Value, slots>::remove(pmem::obj::pool_base &pop,
+				 const Value &entry) {
+	for (uint64_t slot = 0; slot < slots; slot++) {
+		if ((bitmap & (1ULL << slot)) && entries[slot] == entry) {
+			bitmap &= ~(1ULL << slot);
+			pop.persist(&bitmap, sizeof(bitmap));
+			return;
+		}
+	}
+}
+
+template <typename Value, uint64_t slots>
+std::vector<Value> array<Value, slots>::sorted() const {
+	std::vector<Value> result;
+	for (uint64_t slot = 0; slot < slots; slot++)
+		if (bitmap & (1ULL << slot))
+			result.push_back(entries[slot]);
+
+	std::sort(result.begin(), result.end());
+
+	return result;
+}
+
+int main()
+{
+	pmem::obj::pool<array<int, 10>> pop;
+
+	try {
+		pop = pmem::obj::pool<array<int, 10>>::create("/daxfs/pmpool", "append_insert",
+						PMEMOBJ_MIN_POOL, 0666);
+
+		auto root = pop.root();
+
+		root->insert(pop, 0);
+		root->insert(pop, 5);
+		root->insert(pop, 3);
+		root->insert(pop, 1);
+		root->insert(pop, 2);
+		root->remove(pop, 3);
+		root->insert(pop, 4);
+
+		for (auto entry : root->sorted())
+			std::cout << entry;
+
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	pop.close();
+
+	return 0;
+}
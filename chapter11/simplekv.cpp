@@ -32,7 +32,7 @@
 
 /*
  * simplekv.cpp -- implementation of simple kv which uses vector to hold
- * values, string as a key and array to hold buckets
+ * values, string as a key and resizable vector to hold buckets
  */
 
 #include <libpmemobj++/make_persistent_atomic.hpp>
@@ -51,7 +51,7 @@ void
 show_usage(char *argv[])
 {
 	std::cerr << "usage: " << argv[0]
-		  << " file-name [get key|put key value]" << std::endl;
+		  << " file-name [get key|put key value|remove key]" << std::endl;
 }
 
 int
@@ -80,6 +80,8 @@ main(int argc, char *argv[])
 			std::cout << r->kv->get(argv[3]) << std::endl;
 		else if (std::string(argv[2]) == "put" && argc == 5)
 			r->kv->put(argv[3], std::stoi(argv[4]));
+		else if (std::string(argv[2]) == "remove" && argc == 4)
+			r->kv->remove(argv[3]);
 		else {
 			show_usage(argv);
 
@@ -32,9 +32,12 @@
 
 /*
  * simplekv.hpp -- implementation of simple kv which uses vector to hold
- * values, string as a key and array to hold buckets
+ * values, string as a key and vector to hold buckets. The bucket vector
+ * doubles in size when the load factor is exceeded and old buckets are
+ * migrated incrementally, a few on every put.
  */
 
+#include <algorithm>
 #include <functional>
 #include <libpmemobj++/p.hpp>
 #include <libpmemobj++/persistent_ptr.hpp>
@@ -44,14 +47,15 @@
 #include <libpmemobj++/utils.hpp>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-#include <libpmemobj++/container/array.hpp>
 #include <libpmemobj++/container/string.hpp>
 #include <libpmemobj++/container/vector.hpp>
 
 /**
  * Value - type of the value stored in hashmap
- * N - number of buckets in hashmap
+ * N - initial number of buckets in hashmap
  */
 template <typename Value, std::size_t N>
 class simple_kv {
@@ -59,21 +63,120 @@ private:
 	using key_type = pmem::obj::string;
 	using bucket_type = pmem::obj::vector<
 			std::pair<key_type, std::size_t>>;
-	using bucket_array_type = pmem::obj::array<bucket_type, N>;
+	using bucket_array_type = pmem::obj::vector<bucket_type>;
 	using value_vector = pmem::obj::vector<Value>;
 
+	static_assert(N > 0, "simple_kv needs at least one bucket");
+
+	/* average number of elements per bucket which triggers resize */
+	static constexpr std::size_t max_load_factor = 4;
+
+	/* number of old buckets migrated on every put during resize */
+	static constexpr std::size_t migration_step = 4;
+
+	/* during resize old_buckets holds the previous table; buckets below
+	 * migrated index are already moved to the new table */
 	bucket_array_type buckets;
+	bucket_array_type old_buckets;
+	pmem::obj::p<std::size_t> migrated;
+	pmem::obj::p<std::size_t> elements;
 	value_vector values;
 
+	/* positions in values vector vacated by remove, reused by put */
+	pmem::obj::vector<std::size_t> free_slots;
+
+	static std::size_t
+	hash(const std::string &key)
+	{
+		return std::hash<std::string>{}(key);
+	}
+
+	static std::size_t
+	hash(const key_type &key)
+	{
+		return hash(std::string(key.c_str(), key.size()));
+	}
+
+	bool
+	resizing() const
+	{
+		return old_buckets.size() != 0;
+	}
+
+	/* returns bucket which currently holds entries with specified hash */
+	const bucket_type &
+	bucket(std::size_t hash) const
+	{
+		if (resizing()) {
+			auto index = hash % old_buckets.size();
+			if (index >= migrated)
+				return old_buckets.const_at(index);
+		}
+
+		return buckets.const_at(hash % buckets.size());
+	}
+
+	bucket_type &
+	bucket(std::size_t hash)
+	{
+		if (resizing()) {
+			auto index = hash % old_buckets.size();
+			if (index >= migrated)
+				return old_buckets[index];
+		}
+
+		return buckets[hash % buckets.size()];
+	}
+
+	/* moves all entries from one old bucket to the new table, must be
+	 * called inside a transaction */
+	void
+	migrate_bucket()
+	{
+		auto &from = old_buckets[migrated];
+
+		for (auto &e : from)
+			buckets[hash(e.first) % buckets.size()].emplace_back(
+				std::move(e));
+
+		from.free_data();
+		migrated = migrated + 1;
+
+		if (migrated == old_buckets.size())
+			old_buckets.free_data();
+	}
+
+	/* performs one step of incremental resize, starting new resize if
+	 * the load factor is exceeded */
+	void
+	rehash(pmem::obj::pool_base &pop)
+	{
+		if (!resizing() &&
+		    elements <= max_load_factor * buckets.size())
+			return;
+
+		pmem::obj::transaction::run(pop, [&] {
+			if (!resizing()) {
+				old_buckets.swap(buckets);
+				buckets.resize(old_buckets.size() * 2);
+				migrated = 0;
+			}
+
+			for (std::size_t i = 0;
+			     i < migration_step && resizing(); i++)
+				migrate_bucket();
+		});
+	}
+
 public:
-	simple_kv() = default;
+	simple_kv() : buckets(N), migrated(0), elements(0)
+	{
+	}
 
 	const Value &
 	get(const std::string &key) const
 	{
-		auto index = std::hash<std::string>{}(key) % N;
-
-		for (const auto &e : buckets[index]) {
+		for (const auto &e : bucket(hash(key))) {
 			if (e.first == key)
 				return values[e.second];
 		}
@@ -84,14 +187,14 @@ public:
 	void
 	put(const std::string &key, const Value &val)
 	{
-		auto index = std::hash<std::string>{}(key) % N;
+		auto h = hash(key);
 
 		/* get pool on which this simple_kv resides */
 		auto pop = pmem::obj::pool_by_vptr(this);
 
 		/* search for element with specified key - if found
 		 * transactionally update its value */
-		for (const auto &e : buckets[index]) {
+		for (const auto &e : bucket(h)) {
 			if (e.first == key) {
 				pmem::obj::transaction::run(
 					pop, [&] { values[e.second] = val; });
@@ -101,11 +204,87 @@ public:
 		}
 
 		/* if there is no element with specified key, insert new value
-		 * to the end of values vector and put reference in proper
-		 * bucket transactionally */
+		 * to a free slot or to the end of values vector and put
+		 * reference in proper bucket transactionally */
+		pmem::obj::transaction::run(pop, [&] {
+			std::size_t slot;
+			if (free_slots.empty()) {
+				values.emplace_back(val);
+				slot = values.size() - 1;
+			} else {
+				slot = free_slots.cback();
+				free_slots.pop_back();
+				values[slot] = val;
+			}
+
+			bucket(h).emplace_back(key, slot);
+			elements = elements + 1;
+		});
+
+		/* move part of the old buckets to the new table */
+		rehash(pop);
+	}
+
+	/* removes element with specified key, its slot in values vector is
+	 * reused by one of the next puts */
+	void
+	remove(const std::string &key)
+	{
+		auto h = hash(key);
+
+		/* get pool on which this simple_kv resides */
+		auto pop = pmem::obj::pool_by_vptr(this);
+
+		auto &b = bucket(h);
+		for (std::size_t i = 0; i < b.size(); i++) {
+			if (b.const_at(i).first == key) {
+				/* last entry of the bucket takes place of the
+				 * removed one, order of entries in a bucket
+				 * does not matter */
+				pmem::obj::transaction::run(pop, [&] {
+					free_slots.emplace_back(
+						b.const_at(i).second);
+					if (i != b.size() - 1)
+						b[i] = std::move(b[b.size() - 1]);
+					b.pop_back();
+
+					elements = elements - 1;
+				});
+
+				return;
+			}
+		}
+
+		throw std::out_of_range("no entry in simplekv");
+	}
+
+	/* puts all elements from batch in a single transaction, if the same
+	 * key appears in the batch more than once only its last value is
+	 * stored */
+	void
+	put_batch(const std::vector<std::pair<std::string, Value>> &batch)
+	{
+		std::unordered_map<std::string, std::size_t> last;
+		for (std::size_t i = 0; i < batch.size(); i++)
+			last[batch[i].first] = i;
+
+		/* get pool on which this simple_kv resides */
+		auto pop = pmem::obj::pool_by_vptr(this);
+
+		/* transactions started by put are nested in this one, so
+		 * the whole batch is committed at once */
 		pmem::obj::transaction::run(pop, [&] {
-			values.emplace_back(val);
-			buckets[index].emplace_back(key, values.size() - 1);
+			/* grow at least twice, so that consecutive batches
+			 * do not reallocate values every time */
+			auto size = values.size() + last.size();
+			if (values.capacity() < size)
+				values.reserve(
+					std::max(size, 2 * values.capacity()));
+
+			for (std::size_t i = 0; i < batch.size(); i++) {
+				if (last[batch[i].first] == i)
+					put(batch[i].first, batch[i].second);
+			}
 		});
 	}
 };
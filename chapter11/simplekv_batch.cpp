@@ -0,0 +1,162 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * simplekv_batch.cpp -- benchmark comparing put with put_batch for both
+ * simple kv implementations. The same keys are inserted one transaction per
+ * key and one transaction per batch.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "simplekv.hpp"
+#include "simplekv_rebuild.hpp"
+
+using kv_type = simple_kv<int, 1024>;
+using pmem_kv_type = simple_kv_persistent<int, 1024>;
+using batch_type = std::vector<std::pair<std::string, int>>;
+
+struct root {
+	pmem::obj::persistent_ptr<kv_type> kv[2];
+	pmem::obj::persistent_ptr<pmem_kv_type> pmem_kv[2];
+};
+
+/* calls f for every batch of keys, returns keys per second */
+template <typename F>
+double
+run(std::size_t keys, std::size_t batch_size, F f)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	batch_type batch;
+	for (std::size_t i = 0; i < keys; i++) {
+		batch.emplace_back("key" + std::to_string(i), i);
+		if (batch.size() == batch_size || i == keys - 1) {
+			f(batch);
+			batch.clear();
+		}
+	}
+
+	std::chrono::duration<double> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	return keys / elapsed.count();
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0]
+			  << " file-name [keys] [batch-size]" << std::endl;
+		return 1;
+	}
+
+	const char *path = argv[1];
+	std::size_t keys = argc > 2 ? std::stoul(argv[2]) : 100000;
+	std::size_t batch_size = argc > 3 ? std::stoul(argv[3]) : 256;
+
+	pmem::obj::pool<root> pop;
+
+	try {
+		pop = pmem::obj::pool<root>::open(path, "simplekv_batch");
+		auto r = pop.root();
+
+		/* start with empty kvs on every run */
+		pmem::obj::transaction::run(pop, [&] {
+			for (int i = 0; i < 2; i++) {
+				if (r->kv[i] != nullptr)
+					pmem::obj::delete_persistent<kv_type>(
+						r->kv[i]);
+				if (r->pmem_kv[i] != nullptr)
+					pmem::obj::delete_persistent<
+						pmem_kv_type>(r->pmem_kv[i]);
+
+				r->kv[i] = pmem::obj::make_persistent<kv_type>();
+				r->pmem_kv[i] = pmem::obj::make_persistent<
+					pmem_kv_type>();
+			}
+		});
+
+		std::cout << "simple_kv put: "
+			  << run(keys, batch_size,
+				 [&](const batch_type &batch) {
+					 for (const auto &e : batch)
+						 r->kv[0]->put(e.first,
+							       e.second);
+				 })
+			  << " keys/s" << std::endl;
+
+		std::cout << "simple_kv put_batch: "
+			  << run(keys, batch_size,
+				 [&](const batch_type &batch) {
+					 r->kv[1]->put_batch(batch);
+				 })
+			  << " keys/s" << std::endl;
+
+		simple_kv_runtime<int, 1024> runtime_kv(r->pmem_kv[0].get());
+		std::cout << "simple_kv_runtime put: "
+			  << run(keys, batch_size,
+				 [&](const batch_type &batch) {
+					 for (const auto &e : batch)
+						 runtime_kv.put(e.first,
+								e.second);
+				 })
+			  << " keys/s" << std::endl;
+
+		simple_kv_runtime<int, 1024> runtime_kv_batch(
+			r->pmem_kv[1].get());
+		std::cout << "simple_kv_runtime put_batch: "
+			  << run(keys, batch_size,
+				 [&](const batch_type &batch) {
+					 runtime_kv_batch.put_batch(batch);
+				 })
+			  << " keys/s" << std::endl;
+	} catch (pmem::pool_error &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr
+			<< "To create pool run: pmempool create obj --layout=simplekv_batch -s 1G path_to_pool"
+			<< std::endl;
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+	}
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * simplekv_concurrent.cpp -- benchmark of simple kv which can be used by
+ * many threads at once. Throughput of get and put operations on random
+ * keys is measured for 1, 2, 4, ... up to the given number of threads.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simplekv_concurrent.hpp"
+
+using kv_type = simple_kv_concurrent<uint64_t, 65536>;
+
+struct root {
+	pmem::obj::persistent_ptr<kv_type> kv;
+};
+
+/* runs ops operations on every thread, returns operations per second */
+template <typename F>
+double
+run(std::size_t threads, std::size_t ops, F op)
+{
+	std::vector<std::thread> workers;
+	auto start = std::chrono::steady_clock::now();
+
+	for (std::size_t t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			std::mt19937_64 generator(t);
+			for (std::size_t i = 0; i < ops; i++)
+				op(generator);
+		});
+	}
+
+	for (auto &w : workers)
+		w.join();
+
+	std::chrono::duration<double> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	return threads * ops / elapsed.count();
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0]
+			  << " file-name [max-threads] [keys] [ops-per-thread]"
+			  << std::endl;
+		return 1;
+	}
+
+	const char *path = argv[1];
+	std::size_t max_threads = argc > 2 ? std::stoul(argv[2]) : 64;
+	std::size_t key_count = argc > 3 ? std::stoul(argv[3]) : 100000;
+	std::size_t ops = argc > 4 ? std::stoul(argv[4]) : 100000;
+
+	pmem::obj::pool<root> pop;
+
+	try {
+		pop = pmem::obj::pool<root>::open(path, "simplekv_concurrent");
+		auto r = pop.root();
+
+		if (r->kv == nullptr) {
+			pmem::obj::transaction::run(pop, [&] {
+				r->kv = pmem::obj::make_persistent<kv_type>();
+			});
+		}
+
+		auto &kv = *r->kv;
+
+		std::vector<std::string> keys;
+		for (std::size_t i = 0; i < key_count; i++) {
+			keys.emplace_back("key" + std::to_string(i));
+			kv.put(keys.back(), i);
+		}
+
+		std::uniform_int_distribution<std::size_t> distribution(
+			0, key_count - 1);
+
+		std::cout << "threads\tget ops/s\tput ops/s" << std::endl;
+
+		for (std::size_t threads = 1; threads <= max_threads;
+		     threads *= 2) {
+			auto get_rate =
+				run(threads, ops, [&](std::mt19937_64 &g) {
+					kv.get(keys[distribution(g)]);
+				});
+			auto put_rate =
+				run(threads, ops, [&](std::mt19937_64 &g) {
+					auto i = distribution(g);
+					kv.put(keys[i], i);
+				});
+
+			std::cout << threads << "\t" << get_rate << "\t"
+				  << put_rate << std::endl;
+		}
+	} catch (pmem::pool_error &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr
+			<< "To create pool run: pmempool create obj --layout=simplekv_concurrent -s 1G path_to_pool"
+			<< std::endl;
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+	}
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * simplekv_concurrent.hpp -- implementation of simple kv which can be used
+ * by many threads at once. Writers lock one of the striped
+ * pmem::obj::mutexes for the whole transaction, readers do not take any
+ * locks, instead they validate what they read with a per stripe version
+ * counter.
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <libpmemobj++/experimental/v.hpp>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/mutex.hpp>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pext.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+#include <libpmemobj++/utils.hpp>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <libpmemobj++/container/array.hpp>
+#include <libpmemobj++/container/string.hpp>
+
+/**
+ * Value - type of the value stored in hashmap, has to be trivially copyable
+ * N - number of buckets in hashmap
+ * Stripes - number of locks, bucket i is protected by lock i % Stripes
+ */
+template <typename Value, std::size_t N, std::size_t Stripes = 64>
+class simple_kv_concurrent {
+private:
+	using key_type = pmem::obj::string;
+
+	static_assert(std::is_trivially_copyable<Value>::value,
+		      "readers copy values without locking");
+
+	/* entries are never freed and their keys and next pointers never
+	 * change after they are linked, so readers can walk the bucket
+	 * lists while writers insert at the head */
+	struct entry {
+		entry(const std::string &key, const Value &value,
+		      pmem::obj::persistent_ptr<entry> next)
+		    : key(key), value(value), next(next)
+		{
+		}
+
+		key_type key;
+		pmem::obj::p<Value> value;
+		pmem::obj::persistent_ptr<entry> next;
+	};
+
+	using version_array = std::array<std::atomic<uint64_t>, Stripes>;
+
+	pmem::obj::array<pmem::obj::persistent_ptr<entry>, N> buckets;
+
+	/* pmem::obj::mutex and pmem::obj::experimental::v are reinitialized
+	 * every time the pool is opened, so a crash cannot leave a stripe
+	 * locked or with an odd version */
+	pmem::obj::mutex locks[Stripes];
+	mutable pmem::obj::experimental::v<version_array> versions;
+
+	static std::size_t
+	hash(const std::string &key)
+	{
+		return std::hash<std::string>{}(key);
+	}
+
+	/* makes version odd for the duration of the modification, so
+	 * readers which overlap with it retry */
+	class write_guard {
+	public:
+		write_guard(std::atomic<uint64_t> &version) : version(version)
+		{
+			version.store(version.load(std::memory_order_relaxed) +
+					      1,
+				      std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+
+		~write_guard()
+		{
+			version.store(version.load(std::memory_order_relaxed) +
+					      1,
+				      std::memory_order_release);
+		}
+
+	private:
+		std::atomic<uint64_t> &version;
+	};
+
+	pmem::obj::persistent_ptr<entry>
+	find(std::size_t index, const std::string &key) const
+	{
+		for (auto e = buckets.const_at(index); e != nullptr;
+		     e = e->next) {
+			if (e->key == key)
+				return e;
+		}
+
+		return nullptr;
+	}
+
+public:
+	simple_kv_concurrent() = default;
+
+	Value
+	get(const std::string &key) const
+	{
+		auto index = hash(key) % N;
+		auto &version = versions.get()[index % Stripes];
+
+		for (;;) {
+			auto before = version.load(std::memory_order_acquire);
+
+			/* writer is in the middle of a transaction */
+			if (before & 1)
+				continue;
+
+			auto e = find(index, key);
+			Value value = e != nullptr ? Value(e->value) : Value();
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (version.load(std::memory_order_relaxed) != before)
+				continue;
+
+			if (e == nullptr)
+				throw std::out_of_range(
+					"no entry in simplekv");
+
+			return value;
+		}
+	}
+
+	void
+	put(const std::string &key, const Value &val)
+	{
+		auto index = hash(key) % N;
+		auto stripe = index % Stripes;
+
+		/* get pool on which this simple_kv_concurrent resides */
+		auto pop = pmem::obj::pool_by_vptr(this);
+
+		/* lock is held until the transaction is committed, so no
+		 * other thread can see or modify uncommitted data */
+		std::unique_lock<pmem::obj::mutex> lock(locks[stripe]);
+		write_guard guard(versions.get()[stripe]);
+
+		auto e = find(index, key);
+		if (e != nullptr) {
+			pmem::obj::transaction::run(pop,
+						    [&] { e->value = val; });
+
+			return;
+		}
+
+		pmem::obj::transaction::run(pop, [&] {
+			buckets[index] = pmem::obj::make_persistent<entry>(
+				key, val, buckets.const_at(index));
+		});
+	}
+};
@@ -0,0 +1,798 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * simplekv_ordered.hpp -- implementation of simple kv which keeps keys in
+ * order, so that they can be scanned by range or by prefix. Elements are
+ * stored in a sorted, singly linked list of persistent leaves. Each leaf
+ * holds two copies of its entries and is modified in the same way as in
+ * versioning_insert.cpp. Splits and merges of leaves use the same
+ * technique: new content is written to the working copy (and to a reserved,
+ * not yet allocated leaf) and made visible by a single publish, so no undo
+ * log is needed. Inner nodes of the b+tree are kept in DRAM and rebuilt from
+ * the list of leaves on restart.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <libpmemobj.h>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/utils.hpp>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Persistent leaf of simple_kv_ordered. Entries are sorted by key, keys
+ * shorter than KeySize are padded with zeros. Each copy of the entries
+ * takes NodeSize bytes, which must be a multiple of the 256-byte block
+ * in which the media writes data internally.
+ */
+template <typename Value, std::size_t KeySize, std::size_t NodeSize>
+struct ordered_leaf {
+	static constexpr std::size_t block_size = 256;
+
+	struct entry {
+		char key[KeySize];
+		Value value;
+	};
+
+	static constexpr std::size_t slots =
+		(NodeSize - sizeof(std::size_t)) / sizeof(entry);
+
+	/* size is placed before entries so that only the used part of
+	 * a copy has to be flushed */
+	struct alignas(block_size) entries_t {
+		std::size_t size;
+		entry entries[slots];
+	};
+
+	static_assert(sizeof(entries_t) == NodeSize,
+		      "NodeSize must be a multiple of the block size");
+	static_assert(slots >= 4, "NodeSize too small for KeySize");
+
+	/* both copies start at a block boundary, current and next share
+	 * the last block */
+	entries_t v[2];
+	uint64_t current;
+	pmem::obj::persistent_ptr<ordered_leaf> next;
+};
+
+/**
+ * Persistent part of simple_kv_ordered - list of leaves.
+ */
+template <typename Value, std::size_t KeySize, std::size_t NodeSize>
+struct simple_kv_ordered_persistent {
+	pmem::obj::persistent_ptr<ordered_leaf<Value, KeySize, NodeSize>> head;
+};
+
+/**
+ * This class is runtime wrapper for simple_kv_ordered_persistent.
+ * Value - type of the value stored in the tree, must be trivially copyable
+ * KeySize - maximum length of a key
+ * NodeSize - size in bytes of one copy of leaf entries
+ */
+template <typename Value, std::size_t KeySize = 16, std::size_t NodeSize = 1024>
+class simple_kv_ordered {
+private:
+	static_assert(std::is_trivially_copyable<Value>::value,
+		      "values are copied to leaves with memcpy");
+
+	using leaf_type = ordered_leaf<Value, KeySize, NodeSize>;
+	using entry_type = typename leaf_type::entry;
+	using entries_type = typename leaf_type::entries_t;
+
+	struct key_type {
+		char data[KeySize];
+	};
+
+	static constexpr std::size_t slots = leaf_type::slots;
+
+	/* leaves are merged only if the result is at most this full, so that
+	 * the next insert does not split them again */
+	static constexpr std::size_t merge_limit = slots * 3 / 4;
+
+	/* maximum number of children of an inner node */
+	static constexpr std::size_t inner_slots = 64;
+
+	/* how many leaves ahead scan prefetches */
+	static constexpr std::size_t prefetch_distance = 4;
+
+	/* keys[i] is the lowest key in subtree of child i + 1, only one of
+	 * children vectors is used depending on the level of the node */
+	struct inner_node {
+		std::vector<key_type> keys;
+		std::vector<std::unique_ptr<inner_node>> children;
+		std::vector<leaf_type *> leaves;
+
+		/* next node on the lowest level, used by scans */
+		inner_node *next = nullptr;
+
+		bool
+		is_bottom() const
+		{
+			return children.empty();
+		}
+	};
+
+	/* position of a leaf on the lowest level of inner nodes */
+	struct leaf_cursor {
+		const inner_node *node;
+		std::size_t idx;
+
+		leaf_type *
+		get() const
+		{
+			return node->leaves[idx];
+		}
+
+		bool
+		valid() const
+		{
+			return node != nullptr;
+		}
+
+		void
+		advance()
+		{
+			if (++idx == node->leaves.size()) {
+				node = node->next;
+				idx = 0;
+			}
+		}
+	};
+
+	simple_kv_ordered_persistent<Value, KeySize, NodeSize> *data;
+	pmem::obj::pool_base pop;
+	std::unique_ptr<inner_node> root;
+
+	/* allocation class which places leaves at block boundaries */
+	unsigned alloc_class;
+
+	static int
+	compare(const char *lhs, const char *rhs)
+	{
+		return std::memcmp(lhs, rhs, KeySize);
+	}
+
+	static key_type
+	make_key(const std::string &key)
+	{
+		if (key.size() > KeySize)
+			throw std::invalid_argument("key too long");
+
+		key_type k;
+		std::memset(k.data, 0, KeySize);
+		std::memcpy(k.data, key.data(), key.size());
+
+		return k;
+	}
+
+	static std::string
+	to_string(const char *key)
+	{
+		return std::string(key, strnlen(key, KeySize));
+	}
+
+	static const entries_type &
+	consistent_copy(const leaf_type *leaf)
+	{
+		return leaf->v[leaf->current];
+	}
+
+	/* returns index of the first entry not less than key */
+	static std::size_t
+	lower_bound(const entries_type &e, const key_type &key)
+	{
+		auto it = std::lower_bound(
+			e.entries, e.entries + e.size, key,
+			[](const entry_type &lhs, const key_type &rhs) {
+				return compare(lhs.key, rhs.data) < 0;
+			});
+
+		return static_cast<std::size_t>(it - e.entries);
+	}
+
+	/* returns index of the child of node which may contain key */
+	static std::size_t
+	child_index(const inner_node *node, const key_type &key)
+	{
+		auto it = std::upper_bound(
+			node->keys.begin(), node->keys.end(), key,
+			[](const key_type &lhs, const key_type &rhs) {
+				return compare(lhs.data, rhs.data) < 0;
+			});
+
+		return static_cast<std::size_t>(it - node->keys.begin());
+	}
+
+	/* returns node on the lowest level which leads to key */
+	inner_node *
+	find_bottom(const key_type &key) const
+	{
+		inner_node *node = root.get();
+		while (!node->is_bottom())
+			node = node->children[child_index(node, key)].get();
+
+		return node;
+	}
+
+	leaf_cursor
+	find_leaf(const key_type &key) const
+	{
+		auto node = find_bottom(key);
+
+		return leaf_cursor{node, child_index(node, key)};
+	}
+
+	static bool
+	contains(const entries_type &e, std::size_t pos, const key_type &key)
+	{
+		return pos < e.size && compare(e.entries[pos].key, key.data) == 0;
+	}
+
+	/* flushes used part of a copy, without draining */
+	void
+	flush(const entries_type &e)
+	{
+		pop.flush(&e,
+			  offsetof(entries_type, entries) +
+				  e.size * sizeof(entry_type));
+	}
+
+	/* flushes the working copy and makes it consistent */
+	void
+	flip(leaf_type *leaf)
+	{
+		flush(leaf->v[1 - leaf->current]);
+		pop.drain();
+
+		leaf->current = 1 - leaf->current;
+		pop.persist(&leaf->current, sizeof(leaf->current));
+	}
+
+	/* reserves memory for a leaf, it is allocated only when the action
+	 * is published */
+	leaf_type *
+	reserve_leaf(pobj_action *act, PMEMoid &oid)
+	{
+		oid = pmemobj_xreserve(pop.handle(), act, sizeof(leaf_type), 0,
+				       POBJ_CLASS_ID(alloc_class));
+		if (OID_IS_NULL(oid))
+			throw std::bad_alloc();
+
+		auto leaf = static_cast<leaf_type *>(pmemobj_direct(oid));
+		leaf->current = 0;
+		leaf->v[0].size = 0;
+		leaf->next = nullptr;
+
+		return leaf;
+	}
+
+	/* prepares two actions which set ptr to oid */
+	void
+	set_ptr(pobj_action *act, pmem::obj::persistent_ptr<leaf_type> &ptr,
+		PMEMoid oid)
+	{
+		pmemobj_set_value(pop.handle(), &act[0],
+				  &ptr.raw_ptr()->pool_uuid_lo,
+				  oid.pool_uuid_lo);
+		pmemobj_set_value(pop.handle(), &act[1], &ptr.raw_ptr()->off,
+				  oid.off);
+	}
+
+	/* prepares action which makes the working copy of leaf consistent */
+	void
+	set_flip(pobj_action *act, leaf_type *leaf)
+	{
+		pmemobj_set_value(pop.handle(), act, &leaf->current,
+				  1 - leaf->current);
+	}
+
+	/* atomically applies all prepared actions */
+	void
+	publish(pobj_action *act, std::size_t n)
+	{
+		if (pmemobj_publish(pop.handle(), act, n) != 0) {
+			pmemobj_cancel(pop.handle(), act, n);
+			throw std::runtime_error("publish failed");
+		}
+	}
+
+	/*
+	 * Writes entries of the consistent copy with key inserted or updated
+	 * to dst. Returns number of written entries, dst must have room
+	 * for slots + 1 entries.
+	 */
+	static std::size_t
+	merge_entry(const leaf_type *leaf, const key_type &key,
+		    const Value &value, entry_type *dst)
+	{
+		auto &consistent = consistent_copy(leaf);
+		auto pos = lower_bound(consistent, key);
+		bool found = contains(consistent, pos, key);
+
+		std::copy(consistent.entries, consistent.entries + pos, dst);
+
+		std::memcpy(dst[pos].key, key.data, KeySize);
+		dst[pos].value = value;
+
+		auto rest = pos + (found ? 1 : 0);
+		std::copy(consistent.entries + rest,
+			  consistent.entries + consistent.size, dst + pos + 1);
+
+		return consistent.size - rest + pos + 1;
+	}
+
+	/*
+	 * Writes entries of the consistent copy of leaf without key to dst.
+	 * Returns number of written entries.
+	 */
+	static std::size_t
+	copy_without(const leaf_type *leaf, const key_type &key,
+		     entry_type *dst)
+	{
+		auto &consistent = consistent_copy(leaf);
+		auto pos = lower_bound(consistent, key);
+		auto end = std::copy(consistent.entries,
+				     consistent.entries + pos, dst);
+
+		if (contains(consistent, pos, key))
+			pos++;
+
+		end = std::copy(consistent.entries + pos,
+				consistent.entries + consistent.size, end);
+
+		return static_cast<std::size_t>(end - dst);
+	}
+
+	/*
+	 * Splits full leaf into two, new leaf holds upper half of the entries
+	 * and is linked after the old one. Returns the new leaf.
+	 *
+	 * The new leaf is only reserved and the lower half is written to the
+	 * working copy of the old leaf. Allocation of the new leaf, linking
+	 * it and flipping current of the old leaf are then published as one
+	 * atomic action, so after a crash either nothing or all of it is
+	 * visible.
+	 */
+	leaf_type *
+	split(leaf_type *leaf, const key_type &key, const Value &value)
+	{
+		entry_type all[slots + 1];
+		auto n = merge_entry(leaf, key, value, all);
+		auto half = n / 2;
+
+		pobj_action act[4];
+		PMEMoid oid;
+		auto right = reserve_leaf(&act[0], oid);
+
+		right->v[0].size = n - half;
+		std::copy(all + half, all + n, right->v[0].entries);
+		right->next = leaf->next;
+		flush(right->v[0]);
+		pop.flush(&right->current,
+			  sizeof(right->current) + sizeof(right->next));
+
+		auto &working = leaf->v[1 - leaf->current];
+		working.size = half;
+		std::copy(all, all + half, working.entries);
+		flush(working);
+		pop.drain();
+
+		set_flip(&act[1], leaf);
+		set_ptr(&act[2], leaf->next, oid);
+		publish(act, 4);
+
+		return right;
+	}
+
+	/*
+	 * Moves entries of the leaf following position idx of node to the
+	 * leaf at idx, skipping key, and frees the emptied leaf. Both leaves
+	 * are changed by one publish in the same way as in split.
+	 */
+	void
+	merge(inner_node *node, std::size_t idx, const key_type &key)
+	{
+		auto left = node->leaves[idx];
+		auto right = node->leaves[idx + 1];
+
+		auto &working = left->v[1 - left->current];
+		auto n = copy_without(left, key, working.entries);
+		working.size =
+			n + copy_without(right, key, working.entries + n);
+		flush(working);
+		pop.drain();
+
+		pobj_action act[4];
+		set_flip(&act[0], left);
+		set_ptr(&act[1], left->next, right->next.raw());
+		pmemobj_defer_free(pop.handle(), left->next.raw(), &act[3]);
+		publish(act, 4);
+
+		node->keys.erase(node->keys.begin() + idx);
+		node->leaves.erase(node->leaves.begin() + idx + 1);
+	}
+
+	/* inserts child after position idx of node */
+	template <typename Child>
+	static void
+	insert_child(std::vector<Child> &children, inner_node *node,
+		     std::size_t idx, const key_type &separator, Child child)
+	{
+		node->keys.insert(node->keys.begin() + idx, separator);
+		children.insert(children.begin() + idx + 1, std::move(child));
+	}
+
+	/* moves upper half of node to a new node, returns the new node and
+	 * the lowest key in its subtree */
+	static std::unique_ptr<inner_node>
+	split(inner_node *node, key_type &separator)
+	{
+		std::unique_ptr<inner_node> right(new inner_node);
+		auto mid = node->keys.size() / 2;
+
+		separator = node->keys[mid];
+		right->keys.assign(node->keys.begin() + mid + 1,
+				   node->keys.end());
+		node->keys.resize(mid);
+
+		if (node->is_bottom()) {
+			right->leaves.assign(node->leaves.begin() + mid + 1,
+					     node->leaves.end());
+			node->leaves.resize(mid + 1);
+
+			right->next = node->next;
+			node->next = right.get();
+		} else {
+			std::move(node->children.begin() + mid + 1,
+				  node->children.end(),
+				  std::back_inserter(right->children));
+			node->children.resize(mid + 1);
+		}
+
+		return right;
+	}
+
+	/*
+	 * Inserts key into subtree of node. If node has to be split, returns
+	 * the new node and sets separator to the lowest key in its subtree.
+	 */
+	std::unique_ptr<inner_node>
+	insert(inner_node *node, const key_type &key, const Value &value,
+	       key_type &separator)
+	{
+		auto idx = child_index(node, key);
+
+		if (node->is_bottom()) {
+			auto leaf = node->leaves[idx];
+			auto &consistent = consistent_copy(leaf);
+			auto pos = lower_bound(consistent, key);
+			if (contains(consistent, pos, key) ||
+			    consistent.size < slots) {
+				auto &working = leaf->v[1 - leaf->current];
+				working.size =
+					merge_entry(leaf, key, value,
+						    working.entries);
+				flip(leaf);
+
+				return nullptr;
+			}
+
+			auto right = split(leaf, key, value);
+			key_type low;
+			std::memcpy(low.data, right->v[0].entries[0].key,
+				    KeySize);
+			insert_child(node->leaves, node, idx, low, right);
+		} else {
+			key_type low;
+			auto child = insert(node->children[idx].get(), key,
+					    value, low);
+			if (!child)
+				return nullptr;
+
+			insert_child(node->children, node, idx, low,
+				     std::move(child));
+		}
+
+		if (node->keys.size() < inner_slots)
+			return nullptr;
+
+		return split(node, separator);
+	}
+
+	/* builds inner nodes bottom-up from the list of leaves */
+	void
+	rebuild()
+	{
+		std::vector<leaf_type *> leaves;
+		for (auto leaf = data->head.get(); leaf != nullptr;
+		     leaf = leaf->next.get()) {
+			if (leaf->next != nullptr)
+				__builtin_prefetch(&leaf->next->current);
+			leaves.push_back(leaf);
+		}
+
+		/* nodes of the level being built with lowest keys of their
+		 * subtrees, a leaf left empty by remove gets the lowest key
+		 * of the next non-empty leaf, so that no key is routed to it */
+		std::vector<std::unique_ptr<inner_node>> level;
+		std::vector<key_type> lows(leaves.size());
+
+		key_type low;
+		std::memset(low.data, 0xff, KeySize);
+		for (std::size_t i = leaves.size(); i-- > 0;) {
+			auto &consistent = consistent_copy(leaves[i]);
+			if (consistent.size > 0)
+				std::memcpy(low.data, consistent.entries[0].key,
+					    KeySize);
+			lows[i] = low;
+		}
+
+		std::vector<key_type> level_lows;
+		inner_node *prev = nullptr;
+		for (std::size_t i = 0; i < leaves.size(); i++) {
+			if (i % inner_slots == 0) {
+				level.emplace_back(new inner_node);
+				level_lows.push_back(lows[i]);
+				if (prev)
+					prev->next = level.back().get();
+				prev = level.back().get();
+			} else {
+				prev->keys.push_back(lows[i]);
+			}
+			prev->leaves.push_back(leaves[i]);
+		}
+		lows = std::move(level_lows);
+
+		while (level.size() > 1) {
+			std::vector<std::unique_ptr<inner_node>> upper;
+			std::vector<key_type> upper_lows;
+
+			for (std::size_t i = 0; i < level.size(); i++) {
+				if (i % inner_slots == 0) {
+					upper.emplace_back(new inner_node);
+					upper_lows.push_back(lows[i]);
+				} else {
+					upper.back()->keys.push_back(lows[i]);
+				}
+				upper.back()->children.push_back(
+					std::move(level[i]));
+			}
+
+			level = std::move(upper);
+			lows = std::move(upper_lows);
+		}
+
+		root = std::move(level[0]);
+	}
+
+	static void
+	prefetch_entries(const leaf_type *leaf)
+	{
+		auto &consistent = consistent_copy(leaf);
+		auto p = reinterpret_cast<const char *>(&consistent);
+
+		for (std::size_t off = 0; off < sizeof(entries_type); off += 64)
+			__builtin_prefetch(p + off);
+	}
+
+	/*
+	 * Visits entries starting from the first one not less than begin.
+	 * Header of a leaf is prefetched 2 * prefetch_distance leaves ahead,
+	 * when it has arrived the consistent copy it points to is
+	 * prefetched as well.
+	 */
+	template <typename Visitor>
+	void
+	iterate(const key_type &begin, Visitor visit) const
+	{
+		auto cursor = find_leaf(begin);
+		auto header_ahead = cursor;
+		auto entries_ahead = cursor;
+
+		for (std::size_t i = 0; i < 2 * prefetch_distance; i++) {
+			if (header_ahead.valid()) {
+				__builtin_prefetch(header_ahead.get());
+				header_ahead.advance();
+			}
+			if (i < prefetch_distance && entries_ahead.valid()) {
+				prefetch_entries(entries_ahead.get());
+				entries_ahead.advance();
+			}
+		}
+
+		auto pos = lower_bound(consistent_copy(cursor.get()), begin);
+
+		for (; cursor.valid(); cursor.advance(), pos = 0) {
+			if (header_ahead.valid()) {
+				__builtin_prefetch(header_ahead.get());
+				header_ahead.advance();
+			}
+			if (entries_ahead.valid()) {
+				prefetch_entries(entries_ahead.get());
+				entries_ahead.advance();
+			}
+
+			auto &consistent = consistent_copy(cursor.get());
+			for (; pos < consistent.size; pos++) {
+				if (!visit(consistent.entries[pos].key,
+					   consistent.entries[pos].value))
+					return;
+			}
+		}
+	}
+
+public:
+	simple_kv_ordered(
+		simple_kv_ordered_persistent<Value, KeySize, NodeSize> *data)
+	    : data(data), pop(pmem::obj::pool_by_vptr(data))
+	{
+		pobj_alloc_class_desc desc;
+		desc.unit_size = sizeof(leaf_type);
+		desc.alignment = leaf_type::block_size;
+		desc.units_per_block = 64;
+		desc.header_type = POBJ_HEADER_NONE;
+		if (pmemobj_ctl_set(pop.handle(), "heap.alloc_class.new.desc",
+				    &desc) != 0)
+			throw std::runtime_error(
+				"cannot register allocation class");
+		alloc_class = desc.class_id;
+
+		if (data->head == nullptr) {
+			pobj_action act[3];
+			PMEMoid oid;
+			auto head = reserve_leaf(&act[0], oid);
+			pop.persist(head, sizeof(leaf_type));
+
+			set_ptr(&act[1], data->head, oid);
+			publish(act, 3);
+		}
+
+		rebuild();
+	}
+
+	const Value &
+	get(const std::string &key) const
+	{
+		auto k = make_key(key);
+		auto &consistent = consistent_copy(find_leaf(k).get());
+		auto pos = lower_bound(consistent, k);
+
+		if (pos < consistent.size &&
+		    compare(consistent.entries[pos].key, k.data) == 0)
+			return consistent.entries[pos].value;
+
+		throw std::out_of_range("no entry in simplekv");
+	}
+
+	void
+	put(const std::string &key, const Value &val)
+	{
+		auto k = make_key(key);
+		key_type separator;
+
+		auto right = insert(root.get(), k, val, separator);
+		if (right) {
+			std::unique_ptr<inner_node> new_root(new inner_node);
+			new_root->keys.push_back(separator);
+			new_root->children.push_back(std::move(root));
+			new_root->children.push_back(std::move(right));
+			root = std::move(new_root);
+		}
+	}
+
+	/*
+	 * Removes key. If the leaf becomes less than a quarter full it is
+	 * merged with a neighbour under the same inner node, provided the
+	 * result is at most 3/4 full. Inner nodes are not rebalanced, they
+	 * are built packed again on next open.
+	 */
+	void
+	remove(const std::string &key)
+	{
+		auto k = make_key(key);
+		auto node = find_bottom(k);
+		auto idx = child_index(node, k);
+		auto leaf = node->leaves[idx];
+		auto &consistent = consistent_copy(leaf);
+
+		if (!contains(consistent, lower_bound(consistent, k), k))
+			throw std::out_of_range("no entry in simplekv");
+
+		auto size = consistent.size - 1;
+		if (size < slots / 4) {
+			if (idx > 0 &&
+			    consistent_copy(node->leaves[idx - 1]).size +
+					    size <=
+				    merge_limit) {
+				merge(node, idx - 1, k);
+				return;
+			}
+			if (idx + 1 < node->leaves.size() &&
+			    consistent_copy(node->leaves[idx + 1]).size +
+					    size <=
+				    merge_limit) {
+				merge(node, idx, k);
+				return;
+			}
+		}
+
+		auto &working = leaf->v[1 - leaf->current];
+		working.size = copy_without(leaf, k, working.entries);
+		flip(leaf);
+	}
+
+	/*
+	 * Calls callback(key, value) for keys in [begin, end) in ascending
+	 * order, until the callback returns false. Leaves are visited in
+	 * the order of the lowest level of inner nodes, so the next few can
+	 * be prefetched without following pointers stored in the leaves.
+	 */
+	template <typename Callback>
+	void
+	scan(const std::string &begin, const std::string &end,
+	     Callback callback) const
+	{
+		auto b = make_key(begin);
+		auto e = make_key(end);
+
+		iterate(b, [&](const char *key, const Value &value) {
+			return compare(key, e.data) < 0 &&
+				callback(to_string(key), value);
+		});
+	}
+
+	/*
+	 * Calls callback(key, value) for all keys starting with prefix in
+	 * ascending order, until the callback returns false.
+	 */
+	template <typename Callback>
+	void
+	scan_prefix(const std::string &prefix, Callback callback) const
+	{
+		auto b = make_key(prefix);
+
+		iterate(b, [&](const char *key, const Value &value) {
+			return std::memcmp(key, prefix.data(),
+					   prefix.size()) == 0 &&
+				callback(to_string(key), value);
+		});
+	}
+};
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * simplekv_ordered_bench.cpp -- benchmark comparing put and get throughput
+ * of transactional simple_kv with simple_kv_ordered using different node
+ * sizes. Keys are inserted in random order.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <libpmemobj++/make_persistent.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "simplekv.hpp"
+#include "simplekv_ordered.hpp"
+
+using kv_type = simple_kv<int, 1024>;
+
+template <std::size_t NodeSize>
+using ordered_type = simple_kv_ordered_persistent<int, 16, NodeSize>;
+
+struct root {
+	pmem::obj::persistent_ptr<kv_type> kv;
+	pmem::obj::persistent_ptr<ordered_type<256>> ordered_256;
+	pmem::obj::persistent_ptr<ordered_type<512>> ordered_512;
+	pmem::obj::persistent_ptr<ordered_type<1024>> ordered_1024;
+	pmem::obj::persistent_ptr<ordered_type<2048>> ordered_2048;
+};
+
+/* calls f for every key, returns keys per second */
+template <typename F>
+double
+run(const std::vector<std::string> &keys, F f)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (std::size_t i = 0; i < keys.size(); i++)
+		f(keys[i], static_cast<int>(i));
+
+	std::chrono::duration<double> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	return keys.size() / elapsed.count();
+}
+
+template <std::size_t NodeSize>
+void
+bench_ordered(ordered_type<NodeSize> *data,
+	      const std::vector<std::string> &keys)
+{
+	simple_kv_ordered<int, 16, NodeSize> kv(data);
+
+	std::cout << "simple_kv_ordered<" << NodeSize << "> put: "
+		  << run(keys,
+			 [&](const std::string &key, int value) {
+				 kv.put(key, value);
+			 })
+		  << " keys/s, get: "
+		  << run(keys,
+			 [&](const std::string &key, int) { kv.get(key); })
+		  << " keys/s";
+
+	std::size_t n = 0;
+	auto start = std::chrono::steady_clock::now();
+	kv.scan_prefix("", [&](const std::string &, const int &) {
+		n++;
+		return true;
+	});
+	std::chrono::duration<double> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	std::cout << ", scan: " << n / elapsed.count() << " keys/s"
+		  << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cerr << "usage: " << argv[0] << " file-name [keys]"
+			  << std::endl;
+		return 1;
+	}
+
+	const char *path = argv[1];
+	std::size_t n = argc > 2 ? std::stoul(argv[2]) : 1000000;
+
+	std::vector<std::string> keys;
+	for (std::size_t i = 0; i < n; i++)
+		keys.push_back("key" + std::to_string(i));
+	std::shuffle(keys.begin(), keys.end(), std::mt19937_64(1));
+
+	pmem::obj::pool<root> pop;
+
+	try {
+		pop = pmem::obj::pool<root>::open(path,
+						  "simplekv_ordered_bench");
+		auto r = pop.root();
+
+		if (r->kv != nullptr)
+			throw std::runtime_error(
+				"pool was already used, create a new one");
+
+		pmem::obj::transaction::run(pop, [&] {
+			r->kv = pmem::obj::make_persistent<kv_type>();
+			r->ordered_256 = pmem::obj::make_persistent<
+				ordered_type<256>>();
+			r->ordered_512 = pmem::obj::make_persistent<
+				ordered_type<512>>();
+			r->ordered_1024 = pmem::obj::make_persistent<
+				ordered_type<1024>>();
+			r->ordered_2048 = pmem::obj::make_persistent<
+				ordered_type<2048>>();
+		});
+
+		std::cout << "simple_kv put: "
+			  << run(keys,
+				 [&](const std::string &key, int value) {
+					 r->kv->put(key, value);
+				 })
+			  << " keys/s, get: "
+			  << run(keys,
+				 [&](const std::string &key, int) {
+					 r->kv->get(key);
+				 })
+			  << " keys/s" << std::endl;
+
+		bench_ordered(r->ordered_256.get(), keys);
+		bench_ordered(r->ordered_512.get(), keys);
+		bench_ordered(r->ordered_1024.get(), keys);
+		bench_ordered(r->ordered_2048.get(), keys);
+	} catch (pmem::pool_error &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr
+			<< "To create pool run: pmempool create obj --layout=simplekv_ordered_bench -s 4G path_to_pool"
+			<< std::endl;
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+	}
+
+	pop.close();
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * simplekv_packed.cpp -- example usage of simple kv which uses open
+ * addressing with cache line sized bucket groups
+ */
+
+#include <libpmemobj++/make_persistent_atomic.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <stdexcept>
+
+#include "simplekv_packed.hpp"
+
+using kv_type = simple_kv_packed<int, 16>;
+
+struct root {
+	pmem::obj::persistent_ptr<kv_type> kv;
+};
+
+void
+show_usage(char *argv[])
+{
+	std::cerr << "usage: " << argv[0]
+		  << " file-name [get key|put key value]" << std::endl;
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc < 3) {
+		show_usage(argv);
+		return 1;
+	}
+
+	const char *path = argv[1];
+
+	pmem::obj::pool<root> pop;
+
+	try {
+		pop = pmem::obj::pool<root>::open(path, "simplekv_packed");
+		auto r = pop.root();
+
+		if (r->kv == nullptr) {
+			pmem::obj::transaction::run(pop, [&] {
+				r->kv = pmem::obj::make_persistent<kv_type>();
+			});
+		}
+
+		if (std::string(argv[2]) == "get" && argc == 4)
+			std::cout << r->kv->get(argv[3]) << std::endl;
+		else if (std::string(argv[2]) == "put" && argc == 5)
+			r->kv->put(argv[3], std::stoi(argv[4]));
+		else {
+			show_usage(argv);
+
+			pop.close();
+
+			return 1;
+		}
+	} catch (pmem::pool_error &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr
+			<< "To create pool run: pmempool create obj --layout=simplekv_packed -s 100M path_to_pool"
+			<< std::endl;
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+	}
+
+	pop.close();
+
+	return 0;
+}
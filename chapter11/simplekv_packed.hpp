@@ -0,0 +1,292 @@
+/*
+ * Copyright 2020, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * simplekv_packed.hpp -- implementation of simple kv which uses open
+ * addressing. Buckets are grouped into 64-byte bucket groups, each holding
+ * one byte tag per slot and index of the entry in entries vector. Lookup
+ * compares tags of the whole group first and reads a key only on tag match,
+ * so a negative lookup touches one cache line in most cases.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <libpmemobj++/p.hpp>
+#include <libpmemobj++/persistent_ptr.hpp>
+#include <libpmemobj++/pext.hpp>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj++/transaction.hpp>
+#include <libpmemobj++/utils.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <libpmemobj++/container/string.hpp>
+#include <libpmemobj++/container/vector.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Value - type of the value stored in hashmap
+ * N - initial number of bucket groups in hashmap, must be a power of two
+ */
+template <typename Value, std::size_t N>
+class simple_kv_packed {
+private:
+	using key_type = pmem::obj::string;
+
+	static_assert(N > 0 && (N & (N - 1)) == 0,
+		      "number of bucket groups must be a power of two");
+
+	static constexpr std::size_t cache_line_size = 64;
+	static constexpr std::size_t group_slots = 12;
+
+	/* tag of an empty slot, tags of used slots have highest bit set */
+	static constexpr uint8_t empty_tag = 0;
+
+	/* bucket group occupies exactly one cache line: 16 bytes of tags
+	 * (only first group_slots are used, so all of them can be compared
+	 * with a single SSE2 instruction) and indexes of the entries */
+	struct bucket_group {
+		uint8_t tags[16];
+		uint32_t entries[group_slots];
+	};
+
+	static_assert(sizeof(bucket_group) == cache_line_size,
+		      "bucket group must fill exactly one cache line");
+
+	/* short keys are stored inline in the entry thanks to small string
+	 * optimization of pmem::obj::string */
+	struct entry {
+		entry(const std::string &key, const Value &value)
+		    : key(key), value(value)
+		{
+		}
+
+		key_type key;
+		Value value;
+	};
+
+	/* groups vector has one spare group, so that group array can be
+	 * aligned to the cache line regardless of the allocator alignment */
+	pmem::obj::vector<bucket_group> groups;
+	pmem::obj::vector<entry> entries;
+
+	static std::size_t
+	hash(const std::string &key)
+	{
+		return std::hash<std::string>{}(key);
+	}
+
+	static uint8_t
+	tag(std::size_t hash)
+	{
+		return static_cast<uint8_t>(hash | 0x80);
+	}
+
+	std::size_t
+	group_count() const
+	{
+		return groups.size() - 1;
+	}
+
+	const bucket_group *
+	group_array() const
+	{
+		auto addr = reinterpret_cast<uintptr_t>(groups.cdata());
+		addr = (addr + cache_line_size - 1) & ~(cache_line_size - 1);
+
+		return reinterpret_cast<const bucket_group *>(addr);
+	}
+
+	/* returns bitmask of slots in group g which hold tag t */
+	static unsigned
+	match(const bucket_group &g, uint8_t t)
+	{
+#ifdef __SSE2__
+		auto tags = _mm_loadu_si128(
+			reinterpret_cast<const __m128i *>(g.tags));
+		auto eq = _mm_cmpeq_epi8(tags,
+					 _mm_set1_epi8(static_cast<char>(t)));
+
+		return static_cast<unsigned>(_mm_movemask_epi8(eq)) &
+			((1u << group_slots) - 1);
+#else
+		unsigned mask = 0;
+		for (std::size_t i = 0; i < group_slots; i++)
+			if (g.tags[i] == t)
+				mask |= 1u << i;
+
+		return mask;
+#endif
+	}
+
+	/* returns index of entry with specified key or entries.size() if
+	 * there is no such key */
+	std::size_t
+	find(const std::string &key, std::size_t h) const
+	{
+		auto table = group_array();
+		auto mask = group_count() - 1;
+		auto t = tag(h);
+
+		for (std::size_t i = 0, g = (h >> 7) & mask; i < group_count();
+		     i++, g = (g + 1) & mask) {
+			auto hits = match(table[g], t);
+			while (hits) {
+				auto slot = __builtin_ctz(hits);
+				auto index = table[g].entries[slot];
+				if (entries.const_at(index).key == key)
+					return index;
+
+				hits &= hits - 1;
+			}
+
+			/* key would have been put in this group if it
+			 * existed */
+			if (match(table[g], empty_tag))
+				break;
+		}
+
+		return entries.size();
+	}
+
+	/* places entry index in the first group with a free slot; groups
+	 * on pmem have to be snapshotted, which must be done inside
+	 * a transaction */
+	static void
+	place(bucket_group *table, std::size_t count, std::size_t h,
+	      uint32_t index, bool snapshot)
+	{
+		auto mask = count - 1;
+
+		for (auto g = (h >> 7) & mask;; g = (g + 1) & mask) {
+			auto empty = match(table[g], empty_tag);
+			if (!empty)
+				continue;
+
+			auto slot = __builtin_ctz(empty);
+
+			if (snapshot)
+				pmem::obj::transaction::snapshot(&table[g]);
+			table[g].tags[slot] = tag(h);
+			table[g].entries[slot] = index;
+
+			return;
+		}
+	}
+
+	/* doubles number of bucket groups, must be called inside
+	 * a transaction */
+	void
+	grow()
+	{
+		auto count = group_count() * 2;
+
+		/* build new table in DRAM, so that no group has to be
+		 * snapshotted */
+		std::vector<bucket_group> table(count);
+		for (std::size_t i = 0; i < entries.size(); i++) {
+			const auto &key = entries.const_at(i).key;
+			place(table.data(), count,
+			      hash(std::string(key.c_str(), key.size())),
+			      static_cast<uint32_t>(i), false);
+		}
+
+		/* memory allocated in this transaction does not have to be
+		 * snapshotted either; allocate it first to find where the
+		 * aligned group array will start */
+		groups.free_data();
+		groups.reserve(count + 1);
+
+		auto base = reinterpret_cast<uintptr_t>(groups.cdata());
+		auto offset = reinterpret_cast<uintptr_t>(group_array()) - base;
+
+		/* then copy the table to pmem at once */
+		std::vector<bucket_group> image(count + 1);
+		std::memcpy(reinterpret_cast<char *>(image.data()) + offset,
+			    table.data(), count * sizeof(bucket_group));
+		groups.assign(image.cbegin(), image.cend());
+	}
+
+public:
+	simple_kv_packed() : groups(N + 1)
+	{
+	}
+
+	const Value &
+	get(const std::string &key) const
+	{
+		auto index = find(key, hash(key));
+		if (index == entries.size())
+			throw std::out_of_range("no entry in simplekv");
+
+		return entries.const_at(index).value;
+	}
+
+	void
+	put(const std::string &key, const Value &val)
+	{
+		auto h = hash(key);
+		auto index = find(key, h);
+
+		/* get pool on which this simple_kv_packed resides */
+		auto pop = pmem::obj::pool_by_vptr(this);
+
+		/* if element with specified key exists, transactionally
+		 * update its value */
+		if (index != entries.size()) {
+			pmem::obj::transaction::run(
+				pop, [&] { entries[index].value = val; });
+
+			return;
+		}
+
+		/* otherwise append new entry and put its index in the first
+		 * free slot of the probe sequence; table grows when it is
+		 * 7/8 full to keep probe sequences short */
+		pmem::obj::transaction::run(pop, [&] {
+			entries.emplace_back(key, val);
+
+			if (entries.size() * 8 > group_count() * group_slots * 7)
+				grow();
+			else
+				place(const_cast<bucket_group *>(
+					      group_array()),
+				      group_count(), h,
+				      static_cast<uint32_t>(index), true);
+		});
+	}
+};
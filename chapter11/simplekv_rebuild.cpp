@@ -36,12 +36,19 @@
  * vectors of keys and values on persistent memory and rebuilds volatile hashmap
  * on restart.
  *
+ * Volatile hashmap is rebuilt using the number of threads given on
+ * the command line (number of hardware threads by default). In lazy mode
+ * it is rebuilt in background while commands are already being served.
+ * On exit the index is saved to the pool, so that next run can load it
+ * instead of rebuilding.
+ *
  * This example expects user input from stdin.
  */
 
 #include <libpmemobj++/make_persistent_atomic.hpp>
 #include <libpmemobj++/pool.hpp>
 #include <stdexcept>
+#include <thread>
 
 #include "simplekv_rebuild.hpp"
 
@@ -55,11 +62,17 @@ int
 main(int argc, char *argv[])
 {
 	if (argc < 2) {
-		std::cerr << "usage: " << argv[0] << " file-name" << std::endl;
+		std::cerr << "usage: " << argv[0]
+			  << " file-name [threads] [eager|lazy]" << std::endl;
 		return 1;
 	}
 
 	const char *path = argv[1];
+	std::size_t threads = argc > 2 ? std::stoul(argv[2])
+				       : std::thread::hardware_concurrency();
+	auto mode = argc > 3 && std::string(argv[3]) == "lazy"
+		? rebuild_mode::lazy
+		: rebuild_mode::eager;
 	pmem::obj::pool<root> pop;
 
 	try {
@@ -73,9 +86,32 @@ main(int argc, char *argv[])
 			});
 		}
 
-		auto runtime_kv = simple_kv_runtime<int, 10>(r->kv.get());
-
-		std::cout << "usage: [get key|put key value|exit]" << std::endl;
+		auto keys = r->kv->keys.size();
+		simple_kv_runtime<int, 10> runtime_kv(r->kv.get(), threads,
+						      mode);
+
+		auto report_progress = [&] {
+			if (runtime_kv.rebuild_progress() < 1)
+				std::cout << "index rebuild "
+					  << runtime_kv.rebuild_progress() * 100
+					  << "% done" << std::endl;
+			else if (runtime_kv.loaded_from_snapshot())
+				std::cout << "loaded index of " << keys
+					  << " keys from snapshot in "
+					  << runtime_kv.rebuild_time() << " s"
+					  << std::endl;
+			else
+				std::cout << "rebuilt index of " << keys
+					  << " keys in "
+					  << runtime_kv.rebuild_time() << " s ("
+					  << keys / runtime_kv.rebuild_time()
+					  << " keys/s)" << std::endl;
+		};
+
+		report_progress();
+
+		std::cout << "usage: [get key|put key value|remove key|compact|progress|exit]"
+			  << std::endl;
 
 		std::string op;
 		while (std::cin >> op) {
@@ -87,16 +123,32 @@ main(int argc, char *argv[])
 			else if (op == "put" && std::cin >> key &&
 				 std::cin >> value)
 				runtime_kv.put(key, value);
+			else if (op == "remove" && std::cin >> key)
+				runtime_kv.remove(key);
+			else if (op == "compact") {
+				/* in a server compaction steps would be
+				 * interleaved with requests */
+				std::size_t steps = 0;
+				while (runtime_kv.compact())
+					steps++;
+				std::cout << "compacted in " << steps
+					  << " steps" << std::endl;
+			} else if (op == "progress")
+				report_progress();
 			else if (op == "exit")
 				break;
 			else {
 				std::cout
-					<< "usage: [get key|put key value|exit]"
+					<< "usage: [get key|put key value|remove key|compact|progress|exit]"
 					<< std::endl;
 				continue;
 			}
 		}
 
+		if (!runtime_kv.save_snapshot())
+			std::cout << "index rebuild not finished, snapshot not saved"
+				  << std::endl;
+
 	} catch (pmem::pool_error &e) {
 		std::cerr << e.what() << std::endl;
 		std::cerr
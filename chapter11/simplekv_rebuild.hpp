@@ -37,25 +37,47 @@
  * on restart.
  */
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <iterator>
 #include <libpmemobj++/p.hpp>
 #include <libpmemobj++/persistent_ptr.hpp>
 #include <libpmemobj++/pext.hpp>
 #include <libpmemobj++/pool.hpp>
 #include <libpmemobj++/transaction.hpp>
 #include <libpmemobj++/utils.hpp>
+#include <mutex>
+#include <set>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <libpmemobj++/container/array.hpp>
 #include <libpmemobj++/container/string.hpp>
 #include <libpmemobj++/container/vector.hpp>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMPLEKV_REBUILD_X86
+#include <immintrin.h>
+#endif
+
 template <typename Value, std::size_t N>
 struct simple_kv_persistent;
 
+/**
+ * Defines how simple_kv_runtime rebuilds its volatile index on startup.
+ * eager - index is rebuilt in constructor
+ * lazy - index is rebuilt by a background thread, lookups of keys which
+ *	  are not indexed yet fall back to scanning persistent keys
+ */
+enum class rebuild_mode { eager, lazy };
+
 /**
  * This class is runtime wrapper for simple_kv_peristent.
  * Value - type of the value stored in hashmap
@@ -66,36 +88,597 @@ class simple_kv_runtime {
 private:
 	using volatile_key_type = std::string;
 	using bucket_entry_type = std::pair<volatile_key_type, std::size_t>;
-	using bucket_type = std::vector<bucket_entry_type>;
+
+	/* full hash of each key is kept next to the entry, in a separate
+	 * vector, so that it can be scanned without touching the keys */
+	struct bucket_type {
+		std::vector<std::size_t> hashes;
+		std::vector<bucket_entry_type> entries;
+	};
+
 	using bucket_array_type = std::array<bucket_type, N>;
 
+	/* number of keys indexed by background rebuild in one step */
+	static constexpr std::size_t rebuild_chunk = 1024;
+
 	bucket_array_type buckets;
 	simple_kv_persistent<Value, N> *data;
+	double rebuild_seconds;
+
+	/* keys below rebuild_end existed on startup, those below indexed are
+	 * already in the volatile index */
+	std::size_t rebuild_end;
+	std::atomic<std::size_t> indexed;
+	std::atomic<bool> stop_rebuild;
+
+	/* protects buckets and keys vector while background rebuild runs */
+	mutable std::mutex index_mutex;
+	std::thread rebuild_thread;
+
+	/* set when the index no longer matches the persistent snapshot */
+	bool snapshot_stale;
+	bool snapshot_loaded;
+
+	/* slots marked in persistent free slots bitmap, ordered so that put
+	 * and compaction can take the lowest one */
+	std::set<std::size_t> free_list;
+
+	static std::size_t
+	hash(const std::string &key)
+	{
+		return std::hash<std::string>{}(key);
+	}
+
+#ifdef SIMPLEKV_REBUILD_X86
+	/* compares hashes four at a time, i is left at the first hash
+	 * which was not compared */
+	__attribute__((target("avx2"))) static const bucket_entry_type *
+	find_avx2(const bucket_type &bucket, std::size_t hash,
+		  const std::string &key, std::size_t &i)
+	{
+		auto h = _mm256_set1_epi64x(static_cast<long long>(hash));
+		for (; i + 4 <= bucket.hashes.size(); i += 4) {
+			auto v = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i *>(
+					&bucket.hashes[i]));
+			auto mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+				_mm256_cmpeq_epi64(v, h)));
+
+			while (mask) {
+				auto j = i + __builtin_ctz(mask);
+				auto &e = bucket.entries[j];
+				if (e.first == key)
+					return &e;
+
+				mask &= mask - 1;
+			}
+		}
+
+		return nullptr;
+	}
+#endif
+
+	/* returns entry with specified key or nullptr if there is none,
+	 * keys are compared only if their hashes are equal */
+	static const bucket_entry_type *
+	find(const bucket_type &bucket, std::size_t hash,
+	     const std::string &key)
+	{
+		std::size_t i = 0;
+
+#ifdef SIMPLEKV_REBUILD_X86
+		static const bool avx2 = __builtin_cpu_supports("avx2");
+		if (avx2) {
+			auto e = find_avx2(bucket, hash, key, i);
+			if (e)
+				return e;
+		}
+#endif
+
+		for (; i < bucket.hashes.size(); i++) {
+			if (bucket.hashes[i] == hash &&
+			    bucket.entries[i].first == key)
+				return &bucket.entries[i];
+		}
+
+		return nullptr;
+	}
+
+	static void
+	insert(bucket_type &bucket, std::size_t hash, std::string key,
+	       std::size_t index)
+	{
+		bucket.hashes.emplace_back(hash);
+		bucket.entries.emplace_back(
+			bucket_entry_type{std::move(key), index});
+	}
+
+	/* makes room for count more elements in vector v, capacity grows
+	 * at least twice so that batches do not reallocate every time */
+	template <typename Vector>
+	static void
+	reserve(Vector &v, std::size_t count)
+	{
+		if (v.capacity() < v.size() + count)
+			v.reserve(std::max(v.size() + count, 2 * v.capacity()));
+	}
+
+	/* runs f(0) ... f(threads - 1) on separate threads */
+	template <typename F>
+	static void
+	parallel(std::size_t threads, F f)
+	{
+		std::vector<std::thread> workers;
+		workers.reserve(threads);
+		for (std::size_t t = 0; t < threads; t++)
+			workers.emplace_back(f, t);
+
+		for (auto &w : workers)
+			w.join();
+	}
+
+	/* Rebuilds volatile index using specified number of threads. Each
+	 * thread copies and hashes a contiguous range of keys and sorts the
+	 * key indexes by the range of buckets they belong to. Then each
+	 * thread fills its own range of buckets, so no locking is needed and
+	 * entries end up in the same order as in a serial rebuild. */
+	void
+	rebuild(std::size_t threads)
+	{
+		const auto &keys = data->keys;
+		auto size = keys.size();
+
+		threads = std::max<std::size_t>(
+			1, std::min<std::size_t>(threads, size));
+		auto partitions = std::min<std::size_t>(threads, N);
+
+		std::vector<std::string> volatile_keys(size);
+		std::vector<std::size_t> hashes(size);
+		std::vector<std::vector<std::vector<std::size_t>>> indexes(
+			threads,
+			std::vector<std::vector<std::size_t>>(partitions));
+
+		parallel(threads, [&](std::size_t t) {
+			auto begin = size * t / threads;
+			auto end = size * (t + 1) / threads;
+
+			for (auto i = begin; i < end; i++) {
+				if (is_free(i))
+					continue;
+
+				volatile_keys[i] = std::string(
+					keys.const_at(i).c_str(),
+					keys.const_at(i).size());
+				hashes[i] = hash(volatile_keys[i]);
+
+				auto bucket = hashes[i] % N;
+				indexes[t][bucket * partitions / N].push_back(i);
+			}
+		});
+
+		parallel(partitions, [&](std::size_t p) {
+			for (std::size_t t = 0; t < threads; t++) {
+				for (auto i : indexes[t][p])
+					insert(buckets[hashes[i] % N], hashes[i],
+					       std::move(volatile_keys[i]), i);
+			}
+		});
+	}
+
+	/* indexes keys existing on startup in small steps, so that lookups
+	 * and puts can proceed in between */
+	void
+	background_rebuild()
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		for (auto i = indexed.load(); i < rebuild_end && !stop_rebuild;
+		     i = indexed.load()) {
+			auto end = std::min(i + rebuild_chunk, rebuild_end);
+
+			/* whole step is done under the lock, so that no key
+			 * in this range can be removed or replaced between
+			 * reading and indexing it */
+			std::lock_guard<std::mutex> lock(index_mutex);
+			for (auto j = i; j < end; j++) {
+				if (is_free(j))
+					continue;
+
+				const auto &key = data->keys.const_at(j);
+				auto volatile_key =
+					std::string(key.c_str(), key.size());
+				auto h = hash(volatile_key);
+
+				insert(buckets[h % N], h,
+				       std::move(volatile_key), j);
+			}
+
+			if (end == rebuild_end)
+				rebuild_seconds =
+					std::chrono::duration<double>(
+						std::chrono::steady_clock::
+							now() -
+						start)
+						.count();
+
+			indexed.store(end, std::memory_order_release);
+		}
+	}
+
+	/* returns true if slot in persistent vectors was vacated by remove */
+	bool
+	is_free(std::size_t slot) const
+	{
+		const auto &bitmap = data->free_slots;
+
+		return slot / 64 < bitmap.size() &&
+			(bitmap.const_at(slot / 64) >> (slot % 64)) & 1;
+	}
+
+	/* marks slot in persistent vectors as free or used, must be called
+	 * inside a transaction */
+	void
+	set_free(std::size_t slot, bool free)
+	{
+		auto &bitmap = data->free_slots;
+		auto word = slot / 64;
+		auto bit = uint64_t(1) << (slot % 64);
+
+		if (bitmap.size() <= word) {
+			reserve(bitmap, word + 1 - bitmap.size());
+			bitmap.resize(word + 1);
+		}
+
+		if (free)
+			bitmap[word] |= bit;
+		else
+			bitmap[word] &= ~bit;
+	}
+
+	/* stores element in specified free slot or, if slot is past the end
+	 * of persistent vectors, appends it; returns its position. Must be
+	 * called inside a transaction, slot is taken off free list by the
+	 * caller after the transaction commits. */
+	std::size_t
+	store(std::size_t slot, const std::string &key, const Value &val)
+	{
+		if (slot < data->values.size()) {
+			set_free(slot, false);
+			data->values[slot] = val;
+			data->keys[slot] = key;
+
+			return slot;
+		}
+
+		data->values.emplace_back(val);
+		data->keys.emplace_back(key);
+
+		return data->values.size() - 1;
+	}
+
+	/* returns first free slot, starting from the one pointed by it, which
+	 * can be reused. Slots between indexed_keys and rebuild_end are
+	 * skipped, background rebuild has not reached them yet and would
+	 * index the key stored there for the second time. */
+	std::set<std::size_t>::const_iterator
+	next_free_slot(std::set<std::size_t>::const_iterator it,
+		       std::size_t indexed_keys) const
+	{
+		if (it != free_list.end() && *it >= indexed_keys &&
+		    *it < rebuild_end)
+			it = free_list.lower_bound(rebuild_end);
+
+		return it;
+	}
+
+	/* returns lowest free slot which can be reused or position past the
+	 * end of persistent vectors if there is none */
+	std::size_t
+	free_slot(std::size_t indexed_keys) const
+	{
+		auto it = next_free_slot(free_list.begin(), indexed_keys);
+
+		return it == free_list.end() ? data->values.size() : *it;
+	}
+
+	/* collects slots marked in persistent free slots bitmap */
+	void
+	init_free_list()
+	{
+		const auto &bitmap = data->free_slots;
+
+		for (std::size_t word = 0; word < bitmap.size(); word++) {
+			auto bits = bitmap.const_at(word);
+			for (; bits; bits &= bits - 1)
+				free_list.insert(free_list.end(),
+						 word * 64 +
+							 __builtin_ctzll(bits));
+		}
+	}
+
+	/* moves element from the last slot of persistent vectors to the
+	 * lowest free slot, or drops the last slot if it is free. Must be
+	 * called with at least one free slot. */
+	void
+	compact_step(pmem::obj::pool_base &pop)
+	{
+		auto last = data->values.size() - 1;
+
+		if (*free_list.rbegin() == last) {
+			pmem::obj::transaction::run(pop, [&] {
+				set_free(last, false);
+				data->values.pop_back();
+				data->keys.pop_back();
+
+				auto words = (last + 63) / 64;
+				if (data->free_slots.size() > words)
+					data->free_slots.resize(words);
+			});
+
+			free_list.erase(last);
+
+			return;
+		}
+
+		auto slot = *free_list.begin();
+		const auto &last_key = data->keys.const_at(last);
+		auto key = std::string(last_key.c_str(), last_key.size());
+
+		pmem::obj::transaction::run(pop, [&] {
+			invalidate_snapshot();
+			store(slot, key, data->values.const_at(last));
+			data->values.pop_back();
+			data->keys.pop_back();
+		});
+
+		snapshot_stale = true;
+		free_list.erase(free_list.begin());
+
+		auto &bucket = buckets[hash(key) % N];
+		for (auto &e : bucket.entries) {
+			if (e.second == last) {
+				e.second = slot;
+				break;
+			}
+		}
+	}
+
+	/* returns true if persistent index snapshot was taken at the same
+	 * generation as the persistent data */
+	bool
+	snapshot_valid() const
+	{
+		return data->index_generation == data->generation &&
+			data->index_snapshot.size() >= N;
+	}
+
+	/* fills buckets from persistent index snapshot, only keys are copied,
+	 * none of them has to be hashed */
+	void
+	load_snapshot()
+	{
+		auto snapshot = data->index_snapshot.cdata();
+
+		for (auto &bucket : buckets) {
+			auto count = *snapshot++;
+
+			bucket.hashes.reserve(count);
+			bucket.entries.reserve(count);
+
+			for (uint64_t k = 0; k < count; k++, snapshot += 2) {
+				const auto &key =
+					data->keys.const_at(snapshot[1]);
+				insert(bucket, snapshot[0],
+				       std::string(key.c_str(), key.size()),
+				       snapshot[1]);
+			}
+		}
+	}
+
+	/* marks persistent index snapshot as stale, must be called inside
+	 * a transaction which changes set of keys */
+	void
+	invalidate_snapshot()
+	{
+		if (!snapshot_stale)
+			data->generation = data->generation + 1;
+	}
+
+	bool
+	rebuilding() const
+	{
+		return indexed.load(std::memory_order_acquire) < rebuild_end;
+	}
+
+	/* index_mutex has to be held only while background rebuild runs */
+	std::unique_lock<std::mutex>
+	lock_index() const
+	{
+		if (rebuilding())
+			return std::unique_lock<std::mutex>(index_mutex);
+
+		return std::unique_lock<std::mutex>();
+	}
+
+	/* returns position of specified key in persistent vectors or
+	 * data->values.size() if there is no such key, must be called with
+	 * lock_index() held */
+	std::size_t
+	lookup(const std::string &key, std::size_t h,
+	       std::size_t indexed_keys) const
+	{
+		auto e = find(buckets[h % N], h, key);
+		if (e)
+			return e->second;
+
+		/* keys not indexed yet have to be compared one by one */
+		for (auto i = indexed_keys; i < rebuild_end; i++) {
+			if (data->keys.const_at(i) == key && !is_free(i))
+				return i;
+		}
+
+		return data->values.size();
+	}
 
 public:
-	simple_kv_runtime(simple_kv_persistent<Value, N> *data)
+	/* If index snapshot saved on clean shutdown is up to date, the index
+	 * is loaded from it. Otherwise, in eager mode volatile index is
+	 * rebuilt using specified number of threads before constructor
+	 * returns, in lazy mode it is rebuilt by a single background
+	 * thread */
+	simple_kv_runtime(simple_kv_persistent<Value, N> *data,
+			  std::size_t threads = 1,
+			  rebuild_mode mode = rebuild_mode::eager)
+	    : data(data),
+	      rebuild_seconds(0),
+	      rebuild_end(data->keys.size()),
+	      indexed(0),
+	      stop_rebuild(false),
+	      snapshot_stale(false),
+	      snapshot_loaded(snapshot_valid())
 	{
-		this->data = data;
+		init_free_list();
+
+		if (snapshot_loaded) {
+			auto start = std::chrono::steady_clock::now();
+			load_snapshot();
+			rebuild_seconds = std::chrono::duration<double>(
+						  std::chrono::steady_clock::
+							  now() -
+						  start)
+						  .count();
+			indexed = rebuild_end;
+			return;
+		}
+
+		if (mode == rebuild_mode::lazy) {
+			rebuild_thread = std::thread(
+				&simple_kv_runtime::background_rebuild, this);
+			return;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		rebuild(threads);
+		rebuild_seconds = std::chrono::duration<double>(
+					  std::chrono::steady_clock::now() -
+					  start)
+					  .count();
+		indexed = rebuild_end;
+	}
+
+	~simple_kv_runtime()
+	{
+		stop_rebuild = true;
+		if (rebuild_thread.joinable())
+			rebuild_thread.join();
+	}
+
+	simple_kv_runtime(const simple_kv_runtime &) = delete;
+	simple_kv_runtime &operator=(const simple_kv_runtime &) = delete;
+
+	/* returns time in seconds spent on rebuilding volatile index, valid
+	 * once rebuild_progress() reaches 1 */
+	double
+	rebuild_time() const
+	{
+		return rebuilding() ? 0 : rebuild_seconds;
+	}
+
+	/* returns true if index was loaded from persistent snapshot */
+	bool
+	loaded_from_snapshot() const
+	{
+		return snapshot_loaded;
+	}
+
+	/* Stores hashes and positions of all keys (but not keys themselves)
+	 * on persistent memory, so that next startup can skip hashing.
+	 * Should be called on clean shutdown. Returns false if index is not
+	 * complete yet. */
+	bool
+	save_snapshot()
+	{
+		if (rebuilding())
+			return false;
+
+		std::vector<uint64_t> snapshot;
+		snapshot.reserve(N + 2 * data->keys.size());
+
+		for (const auto &bucket : buckets) {
+			snapshot.push_back(bucket.entries.size());
+			for (std::size_t k = 0; k < bucket.entries.size(); k++) {
+				snapshot.push_back(bucket.hashes[k]);
+				snapshot.push_back(bucket.entries[k].second);
+			}
+		}
+
+		auto pop = pmem::obj::pool_by_vptr(data);
+		pmem::obj::transaction::run(pop, [&] {
+			data->index_snapshot = snapshot;
+			data->index_generation = data->generation;
+		});
+
+		snapshot_stale = false;
+
+		return true;
+	}
+
+	/* Performs up to max_steps steps of compaction. Each step moves one
+	 * element from the end of persistent vectors to the lowest free slot
+	 * (or drops a free slot from the end) in its own transaction and
+	 * updates volatile index accordingly, so compaction can be
+	 * interleaved with other operations. Once there are no free slots
+	 * left, capacity of the vectors is shrunk. Returns true if there is
+	 * more work to do. Does nothing while background rebuild runs. */
+	bool
+	compact(std::size_t max_steps = 1)
+	{
+		if (rebuilding())
+			return true;
+
+		/* get pool on which persistent data resides */
+		auto pop = pmem::obj::pool_by_vptr(data);
+
+		for (std::size_t i = 0; i < max_steps && !free_list.empty();
+		     i++)
+			compact_step(pop);
 
-		for (std::size_t i = 0; i < data->values.size(); i++) {
-			auto volatile_key = std::string(data->keys[i].c_str(),
-							data->keys[i].size());
+		if (!free_list.empty())
+			return true;
 
-			auto index = std::hash<std::string>{}(volatile_key) % N;
-			buckets[index].emplace_back(
-				bucket_entry_type{volatile_key, i});
+		if (data->values.capacity() != data->values.size()) {
+			pmem::obj::transaction::run(pop, [&] {
+				data->values.shrink_to_fit();
+				data->keys.shrink_to_fit();
+				data->free_slots.shrink_to_fit();
+			});
 		}
+
+		return false;
+	}
+
+	/* returns fraction of keys existing on startup which are already in
+	 * volatile index */
+	double
+	rebuild_progress() const
+	{
+		if (rebuild_end == 0)
+			return 1;
+
+		return static_cast<double>(indexed.load()) / rebuild_end;
 	}
 
 	const Value &
 	get(const std::string &key) const
 	{
-		auto index = std::hash<std::string>{}(key) % N;
+		auto h = hash(key);
+		auto indexed_keys = indexed.load(std::memory_order_acquire);
 
-		for (const auto &e : buckets[index]) {
-			if (e.first == key)
-				return data->values[e.second];
-		}
+		auto lock = lock_index();
+		auto index = lookup(key, h, indexed_keys);
+
+		if (index != data->values.size())
+			return data->values[index];
 
 		throw std::out_of_range("no entry in simplekv");
 	}
@@ -103,32 +686,159 @@ public:
 	void
 	put(const std::string &key, const Value &val)
 	{
-		auto index = std::hash<std::string>{}(key) % N;
+		auto h = hash(key);
+		auto indexed_keys = indexed.load(std::memory_order_acquire);
 
 		/* get pool on which persistent data resides */
 		auto pop = pmem::obj::pool_by_vptr(data);
 
+		auto lock = lock_index();
+
 		/* search for element with specified key - if found
 		 * transactionally update its value */
-		for (const auto &e : buckets[index]) {
-			if (e.first == key) {
-				pmem::obj::transaction::run(pop, [&] {
-					data->values[e.second] = val;
-				});
+		auto index = lookup(key, h, indexed_keys);
+		if (index != data->values.size()) {
+			pmem::obj::transaction::run(pop, [&] {
+				data->values[index] = val;
+			});
 
-				return;
-			}
+			return;
 		}
 
 		/* if there is no element with specified key, insert new value
-		 * to the end of values vector and key to keys vector
-		 * transactionally */
+		 * and key to a free slot or to the end of values and keys
+		 * vectors transactionally */
+		pmem::obj::transaction::run(pop, [&] {
+			invalidate_snapshot();
+			index = store(free_slot(indexed_keys), key, val);
+		});
+
+		snapshot_stale = true;
+		free_list.erase(index);
+		insert(buckets[h % N], h, key, index);
+	}
+
+	/* removes element with specified key, its slot in persistent vectors
+	 * is reused by one of the next puts */
+	void
+	remove(const std::string &key)
+	{
+		auto h = hash(key);
+		auto indexed_keys = indexed.load(std::memory_order_acquire);
+
+		/* get pool on which persistent data resides */
+		auto pop = pmem::obj::pool_by_vptr(data);
+
+		auto lock = lock_index();
+
+		auto index = lookup(key, h, indexed_keys);
+		if (index == data->values.size())
+			throw std::out_of_range("no entry in simplekv");
+
 		pmem::obj::transaction::run(pop, [&] {
-			data->values.emplace_back(val);
-			data->keys.emplace_back(key);
+			invalidate_snapshot();
+			set_free(index, true);
+			data->keys[index].clear();
 		});
 
-		buckets[index].emplace_back(key, data->values.size() - 1);
+		snapshot_stale = true;
+		free_list.insert(index);
+
+		/* key may not be indexed yet if background rebuild runs,
+		 * order of entries in a bucket does not matter */
+		auto &bucket = buckets[h % N];
+		for (std::size_t i = 0; i < bucket.entries.size(); i++) {
+			if (bucket.entries[i].second != index)
+				continue;
+
+			bucket.hashes[i] = bucket.hashes.back();
+			bucket.entries[i] = std::move(bucket.entries.back());
+			bucket.hashes.pop_back();
+			bucket.entries.pop_back();
+
+			break;
+		}
+	}
+
+	/* puts all elements from batch in a single transaction, if the same
+	 * key appears in the batch more than once only its last value is
+	 * stored */
+	void
+	put_batch(const std::vector<std::pair<std::string, Value>> &batch)
+	{
+		std::unordered_map<std::string, std::size_t> last;
+		for (std::size_t i = 0; i < batch.size(); i++)
+			last[batch[i].first] = i;
+
+		auto indexed_keys = indexed.load(std::memory_order_acquire);
+
+		/* get pool on which persistent data resides */
+		auto pop = pmem::obj::pool_by_vptr(data);
+
+		auto lock = lock_index();
+
+		/* hashes and batch positions of the new keys and slots they
+		 * are stored in, they are put in the volatile index only after
+		 * the transaction commits */
+		std::vector<std::pair<std::size_t, std::size_t>> inserted;
+		std::vector<std::size_t> slots;
+
+		pmem::obj::transaction::run(pop, [&] {
+			inserted.clear();
+			slots.clear();
+
+			for (std::size_t i = 0; i < batch.size(); i++) {
+				const auto &key = batch[i].first;
+				if (last[key] != i)
+					continue;
+
+				auto h = hash(key);
+				auto index = lookup(key, h, indexed_keys);
+				if (index != data->values.size())
+					data->values[index] = batch[i].second;
+				else
+					inserted.emplace_back(h, i);
+			}
+
+			if (inserted.empty())
+				return;
+
+			invalidate_snapshot();
+
+			if (inserted.size() > free_list.size()) {
+				auto n = inserted.size() - free_list.size();
+				reserve(data->values, n);
+				reserve(data->keys, n);
+			}
+
+			auto slot = next_free_slot(free_list.begin(),
+						   indexed_keys);
+			for (const auto &e : inserted) {
+				const auto &element = batch[e.second];
+				auto position = data->values.size();
+				if (slot != free_list.end()) {
+					position = *slot;
+					slot = next_free_slot(std::next(slot),
+							      indexed_keys);
+				}
+
+				slots.push_back(store(position, element.first,
+						      element.second));
+			}
+		});
+
+		if (inserted.empty())
+			return;
+
+		snapshot_stale = true;
+		for (auto slot : slots)
+			free_list.erase(slot);
+
+		for (std::size_t k = 0; k < inserted.size(); k++) {
+			auto h = inserted[k].first;
+			insert(buckets[h % N], h,
+			       batch[inserted[k].second].first, slots[k]);
+		}
 	}
 };
 
@@ -148,4 +858,16 @@ struct simple_kv_persistent {
 	 * entire pair would have to be snapshotted in case of value update */
 	value_vector values;
 	key_vector keys;
+
+	/* bit i is set if i-th slot of values and keys was vacated by remove
+	 * and can be reused */
+	pmem::obj::vector<uint64_t> free_slots;
+
+	/* generation is incremented whenever set of keys changes, index
+	 * snapshot can be used only if it was taken at the same generation.
+	 * For every bucket snapshot holds number of its entries followed by
+	 * hash and position of each entry. */
+	pmem::obj::p<uint64_t> generation;
+	pmem::obj::p<uint64_t> index_generation;
+	pmem::obj::vector<uint64_t> index_snapshot;
 };
@@ -33,11 +33,32 @@
 /* This is simplified version of insert operation from b+tree:
  * https://github.com/pmem/pmemkv/blob/master/src/engines-experimental/stree/persistent_b_tree.h */
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <utility>
 
 #include "libpmemobj++/pool.hpp"
 #include "libpmemobj++/persistent_ptr.hpp"
 
+#define CACHELINE_SIZE 64
+
+/* number of cache lines flushed so far, shows how much of the node each
+ * insert actually writes back */
+static std::size_t flushed_lines = 0;
+
+static void flush_range(pmem::obj::pool_base &pop, const void *addr,
+			std::size_t len) {
+	if (len == 0)
+		return;
+
+	auto begin = reinterpret_cast<uintptr_t>(addr) & ~(uintptr_t)(CACHELINE_SIZE - 1);
+	auto end = reinterpret_cast<uintptr_t>(addr) + len;
+	flushed_lines += (end - begin + CACHELINE_SIZE - 1) / CACHELINE_SIZE;
+
+	pop.flush(addr, len);
+}
+
 template <typename Value, uint64_t slots>
 struct entries_t {
         Value entries[slots];
@@ -48,15 +69,21 @@ template <typename Value, uint64_t slots>
 class array {
 public:
 	void insert(pmem::obj::pool_base &pop, const Value &entry);
-	void insert_element(pmem::obj::pool_base &pop, const Value &entry);
+	std::pair<std::size_t, std::size_t>
+	insert_element(pmem::obj::pool_base &pop, const Value &entry);
 
         entries_t<Value, slots> v[2];
         uint32_t current;
 };
 
+/* Returns range of working copy entries which were modified. Entries
+ * which already hold the right value (typically the ones before the insert
+ * position, left there by the insert before the previous one) are not
+ * written, so they do not have to be flushed. */
 template <typename Value, uint64_t slots>
-void array<Value, slots>::insert_element(pmem::obj::pool_base &pop,
-					const Value &entry) {
+std::pair<std::size_t, std::size_t>
+array<Value, slots>::insert_element(pmem::obj::pool_base &pop,
+				    const Value &entry) {
 	auto &working_copy = v[1 - current];
 	auto &consistent_copy = v[current];
 
@@ -64,31 +91,47 @@ void array<Value, slots>::insert_element(pmem::obj::pool_base &pop,
 		std::begin(consistent_copy.entries),
 		std::begin(consistent_copy.entries) + consistent_copy.size,
 		entry);
-	auto working_insert_position = std::begin(working_copy.entries) +
-		std::distance(std::begin(consistent_copy.entries),
-		consistent_insert_position);
+	std::size_t pos = std::distance(std::begin(consistent_copy.entries),
+					consistent_insert_position);
 
-	std::copy(std::begin(consistent_copy.entries),
-		  consistent_insert_position,
-		  std::begin(working_copy.entries));
+	std::size_t first = slots, last = 0;
+	auto write = [&](std::size_t i, const Value &value) {
+		if (working_copy.entries[i] == value)
+			return;
 
-	*working_insert_position = entry;
+		working_copy.entries[i] = value;
+		first = std::min(first, i);
+		last = i + 1;
+	};
 
-	std::copy(consistent_insert_position,
-		  std::begin(consistent_copy.entries) + consistent_copy.size,
-		  working_insert_position + 1);
+	for (std::size_t i = 0; i < pos; i++)
+		write(i, consistent_copy.entries[i]);
+
+	write(pos, entry);
+
+	for (std::size_t i = pos; i < consistent_copy.size; i++)
+		write(i + 1, consistent_copy.entries[i]);
 
 	working_copy.size = consistent_copy.size + 1;
+
+	return first < last ? std::make_pair(first, last)
+			    : std::make_pair(std::size_t(0), std::size_t(0));
 }
 
 template <typename Value, uint64_t slots>
 void array<Value, slots>::insert(pmem::obj::pool_base &pop,
 			 const Value &entry){
-	insert_element(pop, entry);
-	pop.persist(&(v[1 - current]), sizeof(entries_t<Value, slots>));
+	auto dirty = insert_element(pop, entry);
+	auto &working_copy = v[1 - current];
+
+	flush_range(pop, &working_copy.entries[dirty.first],
+		    (dirty.second - dirty.first) * sizeof(Value));
+	flush_range(pop, &working_copy.size, sizeof(working_copy.size));
+	pop.drain();
 
 	current = 1 - current;
-	pop.persist(&current, sizeof(current));
+	flush_range(pop, &current, sizeof(current));
+	pop.drain();
 }
 
 int main()
@@ -109,6 +152,10 @@ int main()
 
 		for (int i = 0; i < root->v[root->current].size; i++)
 			std::cout << root->v[root->current].entries[i];
+		std::cout << std::endl;
+
+		std::cout << "flushed " << flushed_lines
+			  << " cache lines in 5 inserts" << std::endl;
 
 	} catch (std::exception &e) {
 		std::cerr << e.what() << std::endl;